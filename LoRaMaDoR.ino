@@ -12,6 +12,7 @@
 #include "src/Timestamp.h"
 #include "src/Console.h"
 #include "src/Telnet.h"
+#include "src/Config.h"
 
 #include "driver/adc.h"
 #include <esp_wifi.h>
@@ -43,9 +44,28 @@ void setup()
 	wifi_setup(Net);
 }
 
+#ifdef TICKLESS_LOOP
+// Sleep until the next task is due. Wi-Fi does not survive light
+// sleep, so the loop keeps busy-polling if Wi-Fi is configured.
+static void tickless_sleep()
+{
+	if (wifi_enabled() || console_pending()) {
+		return;
+	}
+	int64_t idle = Net->idle_time(sys_timestamp());
+	if (idle < TICKLESS_MIN_SLEEP) {
+		return;
+	}
+	arduino_light_sleep(idle);
+}
+#endif
+
 void loop()
 {
 	wifi_handle();
 	console_handle();
 	Net->run_tasks(sys_timestamp());
+#ifdef TICKLESS_LOOP
+	tickless_sleep();
+#endif
 }
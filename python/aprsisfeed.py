@@ -14,7 +14,7 @@ def callback(packet):
     pformat = packet['format']
     if pto == 'N0CALL' and pformat == 'message': #put the callsign from APRS you want the messages forward from in pto ==
        print(pto + " " + pfrom + " " + packet['message_text'])
-       msg = '{} {} {}'.format('N0CALL-2',pfrom,packet['message_text']).encode('utf-8') #put the callsign of the LoRaMaDor board you wish to recieve your message at
+       msg = '{}:Z {} {}'.format('N0CALL-2',pfrom,packet['message_text']).encode('utf-8') #put the callsign of the LoRaMaDor board you wish to recieve your message at, Z = compressed
        print("Sending message...")
        print(msg)
        ser = serial.Serial('/dev/ttyUSB0', 115200) #You may need to change the serial port here, the speed should be the same 
@@ -0,0 +1,128 @@
+/*
+ * LoRaMaDoR (LoRa-based mesh network for hams) project
+ * Copyright (c) 2019 PU5EPX
+ */
+
+/* Airtime accounting and duty-cycle limiter.
+ *
+ * Airtime budget is a token bucket. Tokens are milliseconds of airtime,
+ * refilled at the duty-cycle rate (e.g. 10% = 100ms of airtime per
+ * second) up to the burst capacity. A frame may be sent only when the
+ * bucket has enough tokens for it; otherwise the caller should try
+ * again after wait_time().
+ *
+ * Tokens are kept multiplied by 100 so the refill at a percentage rate
+ * is exact in integer arithmetic.
+ *
+ * Airtime actually used is also accounted in 1-minute buckets, for
+ * statistics.
+ */
+
+#include "Airtime.h"
+#include "Timestamp.h"
+
+
+Airtime::Airtime(uint32_t duty_cycle_percent, int64_t burst, int64_t now):
+	duty_cycle(duty_cycle_percent), capacity(burst * 100), tokens(burst * 100),
+	last_refill(now), _deferred(0), waiting(false)
+{
+	for (size_t i = 0; i < HISTORY; ++i) {
+		minute_airtime[i] = 0;
+		minute_number[i] = -1;
+	}
+}
+
+// Estimated airtime of a frame, in ms
+int64_t Airtime::of(size_t len, uint32_t speed_bps)
+{
+	return (int64_t) len * 8 * SECONDS / speed_bps + 1;
+}
+
+void Airtime::refill(int64_t now)
+{
+	if (now <= last_refill) {
+		return;
+	}
+	tokens += (now - last_refill) * duty_cycle;
+	if (tokens > capacity) {
+		tokens = capacity;
+	}
+	last_refill = now;
+}
+
+// Time (ms) to wait until a frame with this airtime may be sent,
+// 0 if it can be sent right now.
+int64_t Airtime::wait_time(int64_t airtime, int64_t now)
+{
+	if (duty_cycle >= 100) {
+		return 0;
+	}
+
+	refill(now);
+
+	// a frame larger than the whole bucket waits for a full bucket
+	int64_t needed = airtime * 100;
+	if (needed > capacity) {
+		needed = capacity;
+	}
+	if (tokens >= needed) {
+		return 0;
+	}
+
+	waiting = true;
+	if (duty_cycle == 0) {
+		// transmission disabled
+		return MINUTES;
+	}
+	return (needed - tokens + duty_cycle - 1) / duty_cycle;
+}
+
+// Account airtime of a frame that has been sent
+void Airtime::used(int64_t airtime, int64_t now)
+{
+	if (waiting) {
+		// counted once, no matter how many times it was retried
+		++_deferred;
+		waiting = false;
+	}
+	refill(now);
+	tokens -= airtime * 100;
+	if (tokens < 0) {
+		tokens = 0;
+	}
+
+	int64_t minute = now / MINUTES;
+	size_t i = minute % HISTORY;
+	if (minute_number[i] != minute) {
+		minute_number[i] = minute;
+		minute_airtime[i] = 0;
+	}
+	minute_airtime[i] += airtime;
+}
+
+// Airtime (ms) used in the current minute
+int64_t Airtime::last_minute(int64_t now) const
+{
+	int64_t minute = now / MINUTES;
+	size_t i = minute % HISTORY;
+	return minute_number[i] == minute ? minute_airtime[i] : 0;
+}
+
+// Airtime (ms) used in the last 60 minutes, including the current one
+int64_t Airtime::last_hour(int64_t now) const
+{
+	int64_t minute = now / MINUTES;
+	int64_t total = 0;
+	for (size_t i = 0; i < HISTORY; ++i) {
+		if (minute_number[i] > (minute - (int64_t) HISTORY)) {
+			total += minute_airtime[i];
+		}
+	}
+	return total;
+}
+
+// Number of frames that had to wait for airtime budget
+uint32_t Airtime::deferred() const
+{
+	return _deferred;
+}
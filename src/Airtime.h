@@ -0,0 +1,51 @@
+/*
+ * LoRaMaDoR (LoRa-based mesh network for hams) project
+ * Copyright (c) 2019 PU5EPX
+ */
+
+// Airtime accounting and duty-cycle limiter
+
+#ifndef __AIRTIME_H
+#define __AIRTIME_H
+
+#include <cstddef>
+#include <cstdint>
+
+class Airtime {
+public:
+	Airtime(uint32_t duty_cycle_percent, int64_t burst, int64_t now);
+
+	static int64_t of(size_t len, uint32_t speed_bps);
+	int64_t wait_time(int64_t airtime, int64_t now);
+	void used(int64_t airtime, int64_t now);
+
+	int64_t last_minute(int64_t now) const;
+	int64_t last_hour(int64_t now) const;
+	uint32_t deferred() const;
+
+private:
+	void refill(int64_t now);
+
+	static const size_t HISTORY = 60;
+
+	// token bucket, in ms of airtime x 100
+	uint32_t duty_cycle;
+	int64_t capacity;
+	int64_t tokens;
+	int64_t last_refill;
+	uint32_t _deferred;
+	// a frame is waiting for budget
+	bool waiting;
+
+	// airtime used in each of the last 60 minutes
+	int64_t minute_airtime[HISTORY];
+	int64_t minute_number[HISTORY];
+
+	Airtime() = delete;
+	Airtime(const Airtime&) = delete;
+	Airtime(Airtime&&) = delete;
+	Airtime& operator=(const Airtime&) = delete;
+	Airtime& operator=(Airtime&&) = delete;
+};
+
+#endif
@@ -5,6 +5,10 @@
 
 #include <Arduino.h>
 #include <stdlib.h>
+#include <esp_sleep.h>
+#include <driver/gpio.h>
+#include <driver/uart.h>
+#include "Config.h"
 #include "Buffer.h"
 #include "Callsign.h"
 
@@ -23,3 +27,35 @@ int32_t arduino_random2(int32_t min, int32_t max)
 void arduino_restart() {
 	ESP.restart();
 }
+
+#ifdef TICKLESS_LOOP
+// Light sleep for at most 'ms' milliseconds. Wakes up earlier
+// when the LoRa radio raises DIO0 or there is serial input.
+// The characters that wake up the UART are lost.
+void arduino_light_sleep(int64_t ms)
+{
+	gpio_num_t dio0 = (gpio_num_t) LORA_DIO0_PIN;
+
+	esp_sleep_enable_timer_wakeup(ms * 1000ULL);
+	gpio_wakeup_enable(dio0, GPIO_INTR_HIGH_LEVEL);
+	esp_sleep_enable_gpio_wakeup();
+	uart_set_wakeup_threshold(UART_NUM_0, 3);
+	esp_sleep_enable_uart_wakeup(0);
+	Serial.flush();
+
+	esp_light_sleep_start();
+
+	// gpio_wakeup_enable() took over the DIO0 interrupt type.
+	// If the radio woke us up, DIO0 is still high and the rising
+	// edge was lost, so arm a level interrupt until the radio
+	// driver handles it, then give back the edge interrupt.
+	gpio_wakeup_disable(dio0);
+	if (digitalRead(LORA_DIO0_PIN)) {
+		gpio_set_intr_type(dio0, GPIO_INTR_HIGH_LEVEL);
+		for (int i = 0; i < 10 && digitalRead(LORA_DIO0_PIN); ++i) {
+			delay(1);
+		}
+	}
+	gpio_set_intr_type(dio0, GPIO_INTR_POSEDGE);
+}
+#endif
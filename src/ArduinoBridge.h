@@ -13,5 +13,6 @@
 uint32_t _arduino_millis();
 int32_t arduino_random2(int32_t min, int32_t max);
 void arduino_restart();
+void arduino_light_sleep(int64_t ms);
 
 #endif
@@ -15,6 +15,10 @@
  *    (e.g. create buffer with predefined length) and it seems to
  *    assume a zero-terminated string in some methods
  *    (case in focus: strcpy() in String::move method.)
+ *
+ * Short strings (callsigns, param keys, idents) are stored inline,
+ * without touching the heap. Longer strings grow geometrically, so
+ * building a string by appending is not quadratic.
  */
 
 #include <stdlib.h>
@@ -30,7 +34,13 @@ class BufferImpl {
 	static void init(Buffer* b, const char *s, size_t len)
 	{
 		b->len = len;
-		b->buf = new char[len + 1];
+		if (len <= Buffer::INLINE_CAP) {
+			b->buf = b->inline_buf;
+			b->cap = Buffer::INLINE_CAP;
+		} else {
+			b->buf = new char[len + 1];
+			b->cap = len;
+		}
 		if (s) {
 			memcpy(b->buf, s, len);
 		} else {
@@ -39,6 +49,35 @@ class BufferImpl {
 		b->buf[len] = 0;
 	}
 
+	static void release(Buffer* b)
+	{
+		if (b->buf != b->inline_buf) {
+			delete [] b->buf;
+		}
+		b->buf = b->inline_buf;
+		b->cap = Buffer::INLINE_CAP;
+		b->len = 0;
+		b->buf[0] = 0;
+	}
+
+	// Take over the contents of another buffer, leaving it empty
+	static void move(Buffer* b, Buffer* moved)
+	{
+		b->len = moved->len;
+		if (moved->buf == moved->inline_buf) {
+			b->buf = b->inline_buf;
+			b->cap = Buffer::INLINE_CAP;
+			memcpy(b->buf, moved->buf, moved->len + 1);
+		} else {
+			b->buf = moved->buf;
+			b->cap = moved->cap;
+			moved->buf = moved->inline_buf;
+		}
+		moved->cap = Buffer::INLINE_CAP;
+		moved->len = 0;
+		moved->buf[0] = 0;
+	}
+
 	static Buffer sprintf(const char *mask, ...)
 	{
 		va_list args;
@@ -80,20 +119,14 @@ Buffer::Buffer(const Buffer& model)
 
 Buffer::Buffer(Buffer&& moved)
 {
-	this->len = moved.len;
-	this->buf = moved.buf;
-	moved.len = 0;
-	moved.buf = 0;
+	BufferImpl::move(this, &moved);
 }
 
 Buffer& Buffer::operator=(Buffer&& moved)
 {
 	if (this != &moved) {
-		delete [] this->buf;
-		this->len = moved.len;
-		this->buf = moved.buf;
-		moved.len = 0;
-		moved.buf = 0;
+		BufferImpl::release(this);
+		BufferImpl::move(this, &moved);
 	}
 	return *this;
 }
@@ -101,12 +134,38 @@ Buffer& Buffer::operator=(Buffer&& moved)
 Buffer& Buffer::operator=(const Buffer& model)
 {
 	if (this != &model) {
-		delete [] buf;
-		BufferImpl::init(this, model.buf, model.len);
+		if (model.len <= cap) {
+			// reuse current storage
+			memcpy(buf, model.buf, model.len + 1);
+			len = model.len;
+		} else {
+			BufferImpl::release(this);
+			BufferImpl::init(this, model.buf, model.len);
+		}
 	}
 	return *this;
 }
 
+// Make room for at least new_cap chars (plus \0). Grows geometrically
+// so a series of appends costs amortized O(1) per char.
+void Buffer::reserve(size_t new_cap)
+{
+	if (new_cap <= this->cap) {
+		return;
+	}
+	if (new_cap < this->cap * 2) {
+		new_cap = this->cap * 2;
+	}
+
+	char *newbuf = new char[new_cap + 1];
+	memcpy(newbuf, this->buf, this->len + 1);
+	if (this->buf != this->inline_buf) {
+		delete [] this->buf;
+	}
+	this->buf = newbuf;
+	this->cap = new_cap;
+}
+
 Buffer& Buffer::operator+=(const Buffer &b)
 {
 	return append(b.buf, b.len);
@@ -123,28 +182,30 @@ Buffer& Buffer::append(const char *s, size_t add_length)
 		return *this;
 	}
 
-	char *oldbuf = this->buf;
-	this->buf = new char[this->len + add_length + 1];
-	memcpy(this->buf, oldbuf, this->len);
-	delete [] oldbuf;
+	if ((this->len + add_length) > this->cap) {
+		if (s >= this->buf && s <= (this->buf + this->len)) {
+			// appending (part of) ourselves; survive reallocation
+			size_t offset = s - this->buf;
+			reserve(this->len + add_length);
+			s = this->buf + offset;
+		} else {
+			reserve(this->len + add_length);
+		}
+	}
 
-	memcpy(this->buf + this->len, s, add_length);
-	this->buf[this->len + add_length] = 0;
+	memmove(this->buf + this->len, s, add_length);
 	this->len += add_length;
+	this->buf[this->len] = 0;
 
 	return *this;
 }
 
 Buffer& Buffer::operator+=(const char c)
 {
-	char *oldbuf = this->buf;
-	this->buf = new char[this->len + 2];
-	memcpy(this->buf, oldbuf, this->len);
-	delete [] oldbuf;
-
+	reserve(this->len + 1);
 	this->buf[this->len] = c;
-	this->buf[this->len + 1] = 0;
 	this->len += 1;
+	this->buf[this->len] = 0;
 
 	return *this;
 }
@@ -166,9 +227,7 @@ Buffer Buffer::operator+(const char b) const
 
 Buffer::~Buffer()
 {
-	delete [] this->buf;
-	this->buf = 0;
-	this->len = 0;
+	BufferImpl::release(this);
 }
 
 Buffer::Buffer(const char *s, int len)
@@ -227,12 +286,9 @@ Buffer& Buffer::cut(int i)
 	if (hi > this->len) {
 		hi = this->len;
 	}
-	
-	char *oldbuf = this->buf;
-	this->buf = new char[this->len - ai + 1];
-	memcpy(this->buf, oldbuf + hi, this->len - ai);
-	delete [] oldbuf;
 
+	// cut in place, capacity is kept
+	memmove(this->buf, this->buf + hi, this->len - ai);
 	this->len -= ai;
 	this->buf[this->len] = 0;
 
@@ -30,6 +30,7 @@ public:
 
 	bool empty() const;
 	size_t length() const;
+	void reserve(size_t);
 	const char* c_str() const;
 	Buffer& uppercase();
 	bool operator==(const char *cmp) const;
@@ -60,8 +61,13 @@ public:
 
 	friend class BufferImpl;
 private:
+	// strings up to this length are stored inline, without heap
+	static const size_t INLINE_CAP = 23;
+
 	char *buf;
 	size_t len;
+	size_t cap;
+	char inline_buf[INLINE_CAP + 1];
 };
 
 #endif
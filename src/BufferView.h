@@ -0,0 +1,57 @@
+/*
+ * LoRaMaDoR (LoRa-based mesh network for hams) project
+ * Copyright (c) 2019 PU5EPX
+ */
+
+// Non-owning view of a slice of a buffer or string (pointer + length).
+// Used to validate received packets in place, before copying
+// anything. The viewed data must outlive the view.
+
+#ifndef __BUFFERVIEW_H
+#define __BUFFERVIEW_H
+
+#include <cstddef>
+#include <cstring>
+#include "Buffer.h"
+
+class BufferView {
+public:
+	BufferView(): _data(""), _len(0) {}
+	BufferView(const char *data, size_t len): _data(data), _len(len) {}
+	BufferView(const Buffer& b): _data(b.c_str()), _len(b.length()) {}
+
+	const char* data() const { return _data; }
+	size_t length() const { return _len; }
+	bool empty() const { return _len == 0; }
+	char operator[](size_t i) const { return _data[i]; }
+
+	// Returns pointer to first occurence of c, or 0
+	const char* find(char c) const {
+		return (const char*) memchr(_data, c, _len);
+	}
+
+	BufferView substr(size_t start, size_t count) const {
+		if (start > _len) {
+			start = _len;
+		}
+		if ((start + count) > _len) {
+			count = _len - start;
+		}
+		return BufferView(_data + start, count);
+	}
+
+	bool operator==(const char *cmp) const {
+		return strlen(cmp) == _len && memcmp(_data, cmp, _len) == 0;
+	}
+
+	// Copy the viewed data into an owned buffer
+	Buffer str() const {
+		return Buffer(_data, _len);
+	}
+
+private:
+	const char *_data;
+	size_t _len;
+};
+
+#endif
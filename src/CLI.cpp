@@ -53,7 +53,7 @@ void logi(const char* a, int32_t b) {
 }
 
 // Print a representation of a received packet
-void app_recv(Ptr<Packet> pkt)
+void app_recv(const Ptr<Packet>& pkt)
 {
 	if (tnc) {
 		Buffer data = pkt->encode_l3(Net->max_payload()).tohex();
@@ -126,6 +126,60 @@ static void cli_parse_repeater(const Buffer &candidate)
 	console_println("cli: Repeater config saved. Effective next restart.");
 }
 
+// Configure or print HMAC verification of relayed packets
+static void cli_parse_verify_relay(const Buffer &candidate)
+{
+	if (candidate.empty()) {
+		console_print("cli: HMAC verification of relayed packets is ");
+		console_println(arduino_nvram_verify_relay_load() ? "1 (on)" : "0 (off)");
+		return;
+	}
+	
+	if (candidate.charAt(0) != '0' && candidate.charAt(0) != '1') {
+		console_println("cli: Invalid new value, should be 0 or 1");
+		return;
+	}
+	
+	arduino_nvram_verify_relay_save(candidate.charAt(0) - '0');
+	console_println("cli: Relay verification config saved. Effective next restart.");
+}
+
+// Configure or print binary header format of originated packets
+static void cli_parse_binary_header(const Buffer &candidate)
+{
+	if (candidate.empty()) {
+		console_print("cli: Binary header format is ");
+		console_println(arduino_nvram_binary_header_load() ? "1 (on)" : "0 (off)");
+		return;
+	}
+	
+	if (candidate.charAt(0) != '0' && candidate.charAt(0) != '1') {
+		console_println("cli: Invalid new value, should be 0 or 1");
+		return;
+	}
+	
+	arduino_nvram_binary_header_save(candidate.charAt(0) - '0');
+	console_println("cli: Binary header config saved. Effective next restart.");
+}
+
+// Configure or print explicit routing of originated packets
+static void cli_parse_explicit_route(const Buffer &candidate)
+{
+	if (candidate.empty()) {
+		console_print("cli: Explicit routing is ");
+		console_println(arduino_nvram_explicit_route_load() ? "1 (on)" : "0 (off)");
+		return;
+	}
+	
+	if (candidate.charAt(0) != '0' && candidate.charAt(0) != '1') {
+		console_println("cli: Invalid new value, should be 0 or 1");
+		return;
+	}
+	
+	arduino_nvram_explicit_route_save(candidate.charAt(0) - '0');
+	console_println("cli: Explicit routing config saved. Effective next restart.");
+}
+
 // Configure or print beacon interval time in seconds
 static void cli_parse_beacon(const Buffer &candidate)
 {
@@ -175,6 +229,68 @@ static void cli_parse_hmac_psk(Buffer candidate)
 	console_println("cli: Activate !debug mode to check HMAC-related issues.");
 }
 
+// Valid callsign prefix: letters, digits and '-', up to a full callsign
+static bool valid_prefix(const Buffer& prefix)
+{
+	if (prefix.empty() || prefix.length() > Callsign::MAX_LEN) {
+		return false;
+	}
+	for (size_t i = 0; i < prefix.length(); ++i) {
+		char c = prefix.charAt(i);
+		if (c >= 'A' && c <= 'Z') {
+		} else if (c >= '0' && c <= '9') {
+		} else if (c == '-') {
+		} else {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Configure HMAC keys per callsign prefix
+static void cli_parse_hmac_key(Buffer candidate)
+{
+	candidate.strip();
+	if (candidate.empty()) {
+		Dict<Buffer> keys = arduino_nvram_hmac_keys_load();
+		if (keys.count() == 0) {
+			console_println("cli: No per-prefix HMAC keys configured.");
+		}
+		for (size_t i = 0; i < keys.count(); ++i) {
+			console_println(Buffer("cli: HMAC key configured for prefix ") + keys.keys()[i]);
+		}
+		return;
+	}
+
+	int sep = candidate.indexOf(' ');
+	if (sep <= 0) {
+		console_println("cli: Usage: !hmackey PREFIX KEY (None to remove)");
+		return;
+	}
+
+	Buffer prefix = candidate.substr(0, sep);
+	Buffer key = candidate.substr(sep + 1);
+	prefix.uppercase();
+	key.strip();
+
+	if (! valid_prefix(prefix)) {
+		console_println("cli: Invalid callsign prefix.");
+		return;
+	}
+
+	if (key.empty() || key.length() > 32) {
+		console_println("cli: Key must have between 1 and 32 ASCII chars.");
+		return;
+	}
+
+	if (key == "None") {
+		key = "";
+	}
+
+	arduino_nvram_hmac_key_save(prefix, key);
+	console_println(Buffer("cli: Key for prefix ") + prefix + " saved, effective immediately.");
+}
+
 // Wi-Fi network name (SSID) configuration
 static void cli_parse_ssid(Buffer candidate)
 {
@@ -286,6 +402,48 @@ static void cli_neigh()
 	console_println("cli: --------------------------");
 }
 
+// Print known unicast routes
+static void cli_routes()
+{
+	auto hops = Net->route_hops();
+	for (size_t i = 0; i < hops.count(); ++i) {
+		Buffer cs = hops.keys()[i];
+		console_println(Buffer("cli:     ") + cs + " via " + hops[cs].via +
+			" cost " + Buffer::itoa(hops[cs].cost));
+	}
+	console_println(Buffer("cli: ") + Buffer::itoa(hops.count()) + " routes");
+}
+
+// Print pool, tx queue, relay and airtime statistics
+static void cli_stats()
+{
+	auto pools = Net->pools();
+	for (size_t i = 0; i < pools.count(); ++i) {
+		const Pool* pool = pools[i];
+		auto b = Buffer("cli: pool ") + pool->name() + " used " +
+			Buffer::itoa(pool->used()) + "/" + Buffer::itoa(pool->capacity()) +
+			" peak " + Buffer::itoa(pool->peak()) +
+			" dropped " + Buffer::itoa(pool->dropped());
+		console_println(b);
+	}
+
+	const TxQueue& txq = Net->tx_queue();
+	console_println(Buffer("cli: tx queue used ") +
+		Buffer::itoa(txq.count()) + "/" + Buffer::itoa(txq.capacity()) +
+		" peak " + Buffer::itoa(txq.peak()) +
+		" dropped " + Buffer::itoa(txq.dropped()));
+	console_println(Buffer("cli: relays queued ") +
+		Buffer::itoa(Net->queued_relays()) + " suppressed " +
+		Buffer::itoa(Net->suppressed_relays()));
+
+	const Airtime& airtime = Net->airtime();
+	int64_t now = sys_timestamp();
+	console_println(Buffer("cli: airtime last minute ") +
+		Buffer::itoa(airtime.last_minute(now)) + "ms, last hour " +
+		Buffer::itoa(airtime.last_hour(now)) + "ms, deferred " +
+		Buffer::itoa(airtime.deferred()));
+}
+
 // Print Wi-Fi status information
 static void cli_wifi()
 {
@@ -302,16 +460,22 @@ static void cli_parse_help()
 	console_println("cli:  !password [PASSWORD]   Get/set Wi-Fi password (None if no password)");
 	console_println("cli:  !repeater [0 or 1]     Get/set repeater function switch");
 	console_println("cli:  !beacon [10..600]      Get/set beacon average time (in seconds)");
+	console_println("cli:  !verifyrelay [0 or 1]  Get/set HMAC verification of relayed packets");
+	console_println("cli:  !binhdr [0 or 1]       Get/set binary header format for sent packets");
+	console_println("cli:  !exroute [0 or 1]      Get/set explicit routing (V, S) of sent packets");
 	console_println("cli:  !hmacpsk [KEY]         Get/Set optional HMAC pre-shared key (None to disable)");
+	console_println("cli:  !hmackey [PREFIX KEY]  List/set HMAC key for a callsign prefix (None to remove)");
 	console_println("cli:  !wifi                  Show Wi-Fi/network status");
 	console_println("cli:  !defconfig             Reset all configurations saved in NVRAM");
 	console_println("cli:  !debug / !nodebug      Enable/disable debug and verbose mode");
 	console_println("cli:  !tnc / !notnc          Enable/disable TNC mode");
 	console_println("cli:  !restart or !reset     Restart controller");
 	console_println("cli:  !neigh                 List known neighbors");
+	console_println("cli:  !routes                List known unicast routes");
 	console_println("cli:  !lastid                Last sent packet #");
 	console_println("cli:  !uptime                Show uptime");
 	console_println("cli:  !version               Show software version");
+	console_println("cli:  !stats                 Show pool, tx queue, relay and airtime statistics");
 	console_println("cli:");
 }
 
@@ -331,9 +495,29 @@ static void cli_parse_meta(Buffer cmd)
 		cli_parse_repeater(cmd);
 	} else if (cmd == "repeater") {
 		cli_parse_repeater("");
+	} else if (cmd.startsWith("verifyrelay ")) {
+		cmd.cut(12);
+		cli_parse_verify_relay(cmd);
+	} else if (cmd == "verifyrelay") {
+		cli_parse_verify_relay("");
+	} else if (cmd.startsWith("binhdr ")) {
+		cmd.cut(7);
+		cli_parse_binary_header(cmd);
+	} else if (cmd == "binhdr") {
+		cli_parse_binary_header("");
+	} else if (cmd.startsWith("exroute ")) {
+		cmd.cut(8);
+		cli_parse_explicit_route(cmd);
+	} else if (cmd == "exroute") {
+		cli_parse_explicit_route("");
 	} else if (cmd.startsWith("beacon ")) {
 		cmd.cut(7);
 		cli_parse_beacon(cmd);
+	} else if (cmd.startsWith("hmackey ")) {
+		cmd.cut(8);
+		cli_parse_hmac_key(cmd);
+	} else if (cmd == "hmackey") {
+		cli_parse_hmac_key("");
 	} else if (cmd.startsWith("hmacpsk ")) {
 		cmd.cut(8);
 		cli_parse_hmac_psk(cmd);
@@ -383,6 +567,10 @@ static void cli_parse_meta(Buffer cmd)
 		cli_uptime();
 	} else if (cmd == "version") {
 		cli_version();
+	} else if (cmd == "stats") {
+		cli_stats();
+	} else if (cmd == "routes") {
+		cli_routes();
 	} else if (cmd == "pktx") {
 		console_println("cli: usage: !pktx <packet encoded in hex format, no spaces>");
 	} else if (cmd.startsWith("pktx ")) {
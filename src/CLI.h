@@ -11,7 +11,7 @@
 void logs(const char*, const char*);
 void logs(const char*, const Buffer&);
 void logi(const char*, int32_t);
-void app_recv(Ptr<Packet>);
+void app_recv(const Ptr<Packet>&);
 void cli_type(const char);
 void cli_simtype(const char *);
 
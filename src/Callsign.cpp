@@ -8,84 +8,188 @@
 
 // Class that validates and encapsulates a callsign.
 
+static_assert(Callsign::MAX_LEN < 2 * sizeof(uint64_t),
+		"Callsign does not fit in packed storage");
+
+static char upper(char c)
+{
+	return (c >= 'a' && c <= 'z') ? (c - 'a' + 'A') : c;
+}
+
 Callsign::Callsign()
 {
-	valid = false;
+	init(BufferView());
 }
 
-Callsign::Callsign(Buffer c)
+Callsign::Callsign(const Buffer& c)
 {
-	c.uppercase();
-	c.strip();
+	init(BufferView(c));
+}
+
+Callsign::Callsign(const BufferView& c)
+{
+	init(c);
+}
+
+void Callsign::init(const BufferView& sc)
+{
+	packed[0] = packed[1] = 0;
+	_hash = 0;
+	len = 0;
+	flags = 0;
+
+	// strip spaces
+	BufferView c = sc;
+	while (!c.empty() && c[0] == ' ') {
+		c = c.substr(1, c.length());
+	}
+	while (!c.empty() && c[c.length() - 1] == ' ') {
+		c = c.substr(0, c.length() - 1);
+	}
+
 	if (! check(c)) {
 		// Invalid callsign is flagged, not stored
-		valid = false;
 		return;
 	}
-	name = c;
-	valid = true;
+
+	char *n = reinterpret_cast<char*>(packed);
+	for (size_t i = 0; i < c.length(); ++i) {
+		n[i] = upper(c[i]);
+	}
+	len = c.length();
+	_hash = hash(c);
+	flags = VALID;
+
+	// Classify pseudo-callsigns once, so the is_*() are bit tests
+	if (n[0] == 'Q') {
+		flags |= Q;
+		switch (n[1]) {
+		/* QL = wildcard for localhost */
+		case 'L':
+			flags |= LO;
+			break;
+		/* QB, QR, QC are broadcast pseudo-callsigns,
+		   QB/QR are reserved for automatic beaconing */
+		case 'B':
+			flags |= BCAST | RESERVED;
+			break;
+		case 'R':
+			flags |= BCAST | RESERVED | REPEATER;
+			break;
+		case 'C':
+			flags |= BCAST;
+			break;
+		}
+	}
 }
 
-bool Callsign::operator==(Buffer other) const
+const char* Callsign::name() const
 {
-	other.uppercase();
-	return valid && name == other;
+	return reinterpret_cast<const char*>(packed);
+}
+
+// Compare with a string, case-insensitive
+bool Callsign::operator==(const Buffer& other) const
+{
+	if (!(flags & VALID) || other.length() != len) {
+		return false;
+	}
+	const char *n = name();
+	const char *o = other.c_str();
+	for (size_t i = 0; i < len; ++i) {
+		if (n[i] != upper(o[i])) {
+			return false;
+		}
+	}
+	return true;
 }
 
 bool Callsign::operator==(const Callsign& other) const
 {
-	return valid && other.valid && name == other.name;
+	return (flags & VALID) && packed[0] == other.packed[0] && packed[1] == other.packed[1];
+}
+
+bool Callsign::operator!=(const Callsign& other) const
+{
+	return !(*this == other);
 }
 
-/* QL = wildcard for localhost */
 bool Callsign::is_lo() const
 {
-	return valid && name == "QL";
+	return flags & LO;
 }
 
-/* QB, QR, QC are broadcast pseudo-callsigns, QB/QR are used by beacon */
 bool Callsign::is_bcast() const
 {
-	return valid && (name == "QB" || name == "QC" || name == "QR");
+	return flags & BCAST;
 }
 
 bool Callsign::is_repeater() const
 {
-	return valid && name == "QR";
+	return flags & REPEATER;
 }
 
-/* QB/QR is reserved for automatic beaconing */
 bool Callsign::is_reserved() const
 {
-	return valid && (name == "QB" || name == "QR");
+	return flags & RESERVED;
 }
 
 bool Callsign::is_q() const
 {
-	return valid && name.startsWith("Q");
+	return flags & Q;
 }
 
 Callsign::operator Buffer() const
 {
-	return name;
+	return Buffer(name(), len);
+}
+
+const char* Callsign::c_str() const
+{
+	return name();
+}
+
+size_t Callsign::length() const
+{
+	return len;
 }
 
 bool Callsign::is_valid() const
 {
-	return valid;
+	return flags & VALID;
+}
+
+// Hash of the callsign, computed once
+uint32_t Callsign::hash() const
+{
+	return _hash;
 }
 
-bool Callsign::check(const Buffer &sbuf)
+// FNV-1a hash of a callsign string. Case-insensitive, so an unvalidated
+// callsign straight from a received packet hashes like the Callsign.
+uint32_t Callsign::hash(const BufferView& c)
+{
+	uint32_t h = 2166136261u;
+	for (size_t i = 0; i < c.length(); ++i) {
+		h ^= (uint8_t) upper(c[i]);
+		h *= 16777619u;
+	}
+	return h;
+}
+
+// Validate a callsign in place. Case-insensitive, since received
+// packets are validated before being copied and uppercased.
+bool Callsign::check(const BufferView &sbuf)
 {
 	size_t length = sbuf.length();
-	const char *s = sbuf.c_str();
+	const char *s = sbuf.data();
 
 	if (length < 2) {
 		return false;
 	}
 
-	char c0 = s[0];
-	char c1 = s[1];
+	char c0 = upper(s[0]);
+	char c1 = upper(s[1]);
 
 	if (c0 < 'A' || c0 > 'Z') {
 		return false;
@@ -97,7 +201,7 @@ bool Callsign::check(const Buffer &sbuf)
 		}
 	}
 
-	const char *ssid_delim = strchr(s, '-');
+	const char *ssid_delim = sbuf.find('-');
 	size_t prefix_length;
 
 	if (ssid_delim) {
@@ -130,7 +234,7 @@ bool Callsign::check(const Buffer &sbuf)
 	}
 
 	for (size_t i = 1; i < prefix_length; ++i) {
-		char c = s[i];
+		char c = upper(s[i]);
 		if (c >= '0' && c <= '9') {
 		} else if (c >= 'A' && c <= 'Z') {
 		} else {
@@ -140,4 +244,3 @@ bool Callsign::check(const Buffer &sbuf)
 
 	return true;
 }
-
@@ -9,26 +9,52 @@
 #define __CALLSIGN_H
 
 #include "Buffer.h"
-#include <cstdarg>
+#include "BufferView.h"
+#include <cstdint>
 
 class Callsign
 {
 public:
+	// 7-char prefix + '-' + 2-digit SSID
+	static const size_t MAX_LEN = 10;
+
 	Callsign();
-	Callsign(Buffer);
+	Callsign(const Buffer&);
+	Callsign(const BufferView&);
 	operator Buffer() const;
+	const char* c_str() const;
+	size_t length() const;
 	bool is_valid() const;
 	bool is_bcast() const;
 	bool is_repeater() const;
 	bool is_q() const;
 	bool is_lo() const;
 	bool is_reserved() const;
-	bool operator==(Buffer) const;
+	uint32_t hash() const;
+	bool operator==(const Buffer&) const;
 	bool operator==(const Callsign&) const;
+	bool operator!=(const Callsign&) const;
+	static bool check(const BufferView&);
+	static uint32_t hash(const BufferView&);
 private:
-	static bool check(const Buffer&);
-	Buffer name;
-	bool valid;
+	void init(const BufferView&);
+	const char* name() const;
+
+	enum {
+		VALID = 1,
+		Q = 2,
+		LO = 4,
+		BCAST = 8,
+		REPEATER = 16,
+		RESERVED = 32,
+	};
+
+	// Name stored inline, uppercase, zero-padded and NUL-terminated,
+	// so two callsigns are compared as two integers.
+	uint64_t packed[2];
+	uint32_t _hash;
+	uint8_t len;
+	uint8_t flags;
 };
 
 #endif
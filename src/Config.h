@@ -8,4 +8,72 @@
 #define SPREAD  7
 #define BWIDTH  125000
 
+/* Light sleep between tasks when Wi-Fi is off. Experimental, not yet
+   validated on hardware: serial characters that wake the CPU up are
+   lost, and DIO0 interrupt type is switched while the radio driver
+   owns it (see arduino_light_sleep()). Uncomment to enable. */
+// #define TICKLESS_LOOP 1
+/* Minimum idle time (ms) worth entering light sleep */
+#define TICKLESS_MIN_SLEEP 10
+/* ESP32 pin connected to LoRa DIO0, wakes up from light sleep.
+   26 is the TTGO LoRa32 / Heltec pin; define it for other boards. */
+#ifndef LORA_DIO0_PIN
+#define LORA_DIO0_PIN 26
+#endif
+
+/* Slots of each generation of the duplicate packet log (power of 2).
+   A generation is rotated early at 3/4 load, so an entry is kept for at
+   least 192 packets; even on a saturated channel (a few packets per
+   second) that is much longer than relayed copies take to arrive.
+   Two generations of 256 slots take about 28k of RAM. */
+#define RECV_LOG_SIZE 256
+
+/* Capacity of memory pools of the rx/relay path (packets and tasks) */
+#define POOL_PACKETS 16
+#define POOL_FWD_TASKS 16
+
+/* Radio links kept in the unicast route table */
+#define ROUTE_TABLE_SIZE 64
+
+/* Frames waiting for transmission */
+#define TX_QUEUE_SIZE 32
+
+/* Withdraw a pending relay after hearing this many copies relayed by
+   others (counter-based flood suppression, 0 to disable) */
+#define RELAY_SUPPRESS_COUNT 2
+
+/* Relay delay weighting by RSSI: percent of the average delay for
+   packets received strongly (near) and weakly (far), linear between */
+#define RELAY_RSSI_NEAR -60
+#define RELAY_RSSI_FAR -115
+#define RELAY_DELAY_NEAR_PCT 150
+#define RELAY_DELAY_FAR_PCT 50
+
+/* Fragmentation: maximum fragments per message, messages under
+   reassembly, sent messages kept for retransmission, and room left
+   in each fragment for params added later: ",H=" plus 12 HMAC chars,
+   ",R", and V growing from the shortest (2) to the longest (10)
+   callsign */
+#define FRAG_MAX_COUNT 16
+#define FRAG_REASSEMBLY_SLOTS 4
+#define FRAG_TX_CACHE 2
+#define FRAG_HEADROOM ((3 + 12) + 2 + (10 - 2))
+
+/* Reliable transport: segments in flight per destination, messages
+   waiting for the window, streams tracked in each direction, and
+   retransmissions before giving up a segment */
+#define RS_WINDOW 4
+#define RS_BACKLOG 16
+#define RS_STREAMS 4
+#define RS_MAX_RETRIES 5
+
+/* Packet IDs reserved at a time, saved to NVRAM once per block */
+#define PACKET_ID_BLOCK 100
+
+/* Maximum transmission duty cycle (percent of airtime, 100 = unlimited).
+   Set it where the band has a duty-cycle limit, e.g. 10 or 1 in EU. */
+#define TX_DUTY_CYCLE 100
+/* Airtime (ms) that may be used in a burst, when budget was saved up */
+#define TX_AIRTIME_BURST 10000
+
 #endif
@@ -48,6 +48,12 @@ void console_handle()
 	}
 }
 
+// There is serial input to handle, or output still to be sent
+bool console_pending()
+{
+	return Serial.available() > 0 || ! output_buffer.empty();
+}
+
 // Print to serial console (through a buffer; see console_handle())
 void serial_print(const char *msg)
 {
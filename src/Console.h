@@ -19,6 +19,7 @@ class Network;
 
 void console_setup(Ptr<Network> net);
 void console_handle();
+bool console_pending();
 void console_telnet_enable();
 void console_telnet_disable();
 
@@ -3,38 +3,131 @@
  * Copyright (c) 2020 PU5EPX
  */
 
+#include <string.h>
 #include "HMACKeys.h"
 #include "NVRAM.h"
-#include "LoRaL2/src/sha256.h"
+#include "Dict.h"
+#include "PrefixMap.h"
 
 static bool valid = false;
-static Buffer psk;
+static const Buffer no_key;
+// Keys by callsign prefix, global PSK is the empty prefix
+static PrefixMap keys;
 
-// TODO allow to store keys per-prefix (with or without SSID, etc.)
-Buffer HMACKeys::get_key_for(const Callsign &c)
+/* HMAC-SHA256 state of a key, computed once. The inner and outer
+ * hashes have already consumed the padded key blocks, so each HMAC
+ * only costs the message blocks plus the final outer block.
+ */
+struct HMACState {
+	Sha256 inner;
+	Sha256 outer;
+};
+
+static const size_t MAX_STATES = 8;
+static Dict<HMACState> states;
+
+// Key for a station, given by the longest matching callsign prefix,
+// or the global PSK. Empty if there is no key at all.
+const Buffer& HMACKeys::get_key_for(const Callsign &c)
 {
 	if (!valid) {
-		psk = arduino_nvram_hmac_psk_load();
+		keys.clear();
+		Buffer psk = arduino_nvram_hmac_psk_load();
+		if (! psk.empty()) {
+			keys.put("", psk);
+		}
+		Dict<Buffer> prefix_keys = arduino_nvram_hmac_keys_load();
+		const Vector<Buffer>& prefixes = prefix_keys.keys();
+		for (size_t i = 0; i < prefixes.count(); ++i) {
+			keys.put(prefixes[i], prefix_keys[prefixes[i]]);
+		}
 		valid = true;
 	}
-	return psk;
+
+	const Buffer *key = keys.longest_match(c.c_str(), c.length());
+	return key ? *key : no_key;
 }
 
 void HMACKeys::invalidate()
 {
 	valid = false;
+	states = Dict<HMACState>();
 }
 
 static const char* hex = "0123456789abcdef";
 
-Buffer HMACKeys::hmac(const Buffer& key, const Buffer& data)
+// Feed a span of bytes to the hash
+void HMACKeys::write(Sha256& sha, const uint8_t* data, size_t len)
+{
+	for (size_t i = 0; i < len; ++i) {
+		sha.write(data[i]);
+	}
+}
+
+static const HMACState& state_for(const Buffer& key)
 {
-	Sha256 hmac;
-	hmac.initHmac((uint8_t*) key.c_str(), key.length());
-	for (size_t i = 0; i < data.length(); ++i) {
-		hmac.write((uint8_t) data.charAt(i));
+	if (states.has(key)) {
+		return states[key];
 	}
-	uint8_t* res = hmac.resultHmac();
+
+	if (states.count() >= MAX_STATES) {
+		states = Dict<HMACState>();
+	}
+
+	// long keys are hashed, short keys are zero-padded
+	uint8_t block[BLOCK_LENGTH];
+	memset(block, 0, BLOCK_LENGTH);
+	if (key.length() > BLOCK_LENGTH) {
+		Sha256 hash;
+		hash.init();
+		HMACKeys::write(hash, (const uint8_t*) key.c_str(), key.length());
+		memcpy(block, hash.result(), HASH_LENGTH);
+	} else {
+		memcpy(block, key.c_str(), key.length());
+	}
+
+	HMACState state;
+	state.inner.init();
+	state.outer.init();
+	for (size_t i = 0; i < BLOCK_LENGTH; ++i) {
+		state.inner.write(block[i] ^ 0x36);
+		state.outer.write(block[i] ^ 0x5c);
+	}
+	states.put(key, state);
+
+	return states[key];
+}
+
+Buffer HMACKeys::hmac(const Buffer& key, const Buffer& data)
+{
+	HMACHasher hasher(key);
+	hasher.write(data);
+	return hasher.result();
+}
+
+HMACHasher::HMACHasher(const Buffer& key)
+{
+	const HMACState& state = state_for(key);
+	inner = state.inner;
+	outer = state.outer;
+}
+
+void HMACHasher::write(const char* data, size_t len)
+{
+	HMACKeys::write(inner, (const uint8_t*) data, len);
+}
+
+void HMACHasher::write(const Buffer& data)
+{
+	write(data.c_str(), data.length());
+}
+
+// HMAC of everything written so far, as hex string
+Buffer HMACHasher::result()
+{
+	HMACKeys::write(outer, inner.result(), HASH_LENGTH);
+	uint8_t* res = outer.result();
+
 	// convert the first 48 bits of HMAC (6 octets) to hex
 	char b64[13];
 	for (size_t i = 0; i < 6; ++i) {
@@ -50,9 +143,7 @@ Buffer HMACKeys::hash_key(const Buffer& key)
 	Sha256 hash;
 	hash.init();
 	hash.write(1);
-	for (size_t i = 0; i < key.length(); ++i) {
-		hash.write((uint8_t) key.charAt(i));
-	}
+	write(hash, (const uint8_t*) key.c_str(), key.length());
 	uint8_t* res = hash.result();
 	char b64[32];
 	for (size_t i = 0; i < 16; ++i) {
@@ -8,13 +8,27 @@
 
 #include "Buffer.h"
 #include "Callsign.h"
+#include "LoRaL2/src/sha256.h"
 
 class HMACKeys {
 public:
-	static Buffer get_key_for(const Callsign &c);
+	static const Buffer& get_key_for(const Callsign &c);
 	static Buffer hmac(const Buffer& key, const Buffer& data);
 	static void invalidate();
 	static Buffer hash_key(const Buffer& key);
+	static void write(Sha256&, const uint8_t*, size_t);
+};
+
+// Incremental HMAC of a message fed in pieces. Does not allocate.
+class HMACHasher {
+public:
+	HMACHasher(const Buffer& key);
+	void write(const char*, size_t);
+	void write(const Buffer&);
+	Buffer result();
+private:
+	Sha256 inner;
+	Sha256 outer;
 };
 
 #endif
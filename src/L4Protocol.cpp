@@ -17,11 +17,17 @@
  * protocol may also handle the packet in their own way.
  * 
  * See Proto_C.cpp (confirm packet) for a concrete example.
+ *
+ * The class may also replace the received packet, e.g. to decode the
+ * message, see Proto_Z.cpp (compression), or hold it back from the
+ * next protocols, see Proto_F.cpp (fragmentation).
  * 
  * 2) a tweaker (concrete implementation of tx()). 
  * This method is called when a packet is sent by the station.
  * All L4 protocols have a chance to analyse and tweak the
  * packet as necessary, independently of the L7 protocol.
+ * A protocol may also hold the packet back, to send it later,
+ * see Proto_RS.cpp (reliable transport).
  *
  * The Proto_HMAC protocol implements both tx() and rx() methods:
  * when a packet is generated by the application protocol, tx()
@@ -37,26 +43,29 @@ L4rxHandlerResponse::L4rxHandlerResponse(bool has_packet, const Callsign& to,
 		const Params& params, const Buffer& msg, bool error,
 		const Buffer& error_msg):
 	has_packet(has_packet), to(to), params(params), msg(msg),
-		error(error), error_msg(error_msg)
+		error(error), error_msg(error_msg), hold(false)
 {}
 
 L4rxHandlerResponse::L4rxHandlerResponse():
 	has_packet(false), to(Callsign()), params(Params()), msg(""),
-		error(false), error_msg("")
+		error(false), error_msg(""), hold(false)
+{}
+
+L4rxHandlerResponse::L4rxHandlerResponse(Ptr<Packet> pkt):
+	has_packet(false), to(Callsign()), params(Params()), msg(""),
+		error(false), error_msg(""), pkt(pkt), hold(false)
 {}
 
 L4txHandlerResponse::L4txHandlerResponse(Ptr<Packet> pkt):
-	pkt(pkt)
+	pkt(pkt), hold(false)
 {}
 
 L4txHandlerResponse::L4txHandlerResponse():
-	pkt(Ptr<Packet>(0))
+	pkt(Ptr<Packet>(0)), hold(false)
 {}
 
 L4Protocol::L4Protocol(Network *net): net(net)
 {
-	// Network becomes the owner
-	net->add_l4protocol(this);
 }
 
 L4Protocol::~L4Protocol()
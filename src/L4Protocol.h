@@ -21,18 +21,25 @@ class Packet;
 struct L4rxHandlerResponse {
 	L4rxHandlerResponse();
 	L4rxHandlerResponse(bool, const Callsign &, const Params&, const Buffer&, bool, const Buffer&);
+	L4rxHandlerResponse(Ptr<Packet>);
 	bool has_packet;
 	Callsign to;
 	Params params;
 	Buffer msg;
 	bool error;
 	Buffer error_msg;
+	// replaces the received packet for the next protocols, if not null
+	Ptr<Packet> pkt;
+	// packet kept by the protocol, not delivered (e.g. a fragment)
+	bool hold;
 };
 
 struct L4txHandlerResponse {
 	L4txHandlerResponse();
 	L4txHandlerResponse(Ptr<Packet>);
 	Ptr<Packet> pkt;
+	// packet kept by the protocol, to be sent later
+	bool hold;
 };
 
 class L4Protocol {
@@ -43,7 +50,7 @@ public:
 	virtual ~L4Protocol();
 protected:
 	Network *net;
-	// This class must be new()ed and not fooled around
+	// This class must be make_ptr()ed, handed to Network and not fooled around
 	L4Protocol() = delete;
 	L4Protocol(const L4Protocol&) = delete;
 	L4Protocol(L4Protocol&&) = delete;
@@ -52,8 +52,6 @@ L7HandlerResponse::L7HandlerResponse():
 
 L7Protocol::L7Protocol(Network *net): net(net)
 {
-	// Network becomes the owner
-	net->add_l7protocol(this);
 }
 
 L7Protocol::~L7Protocol()
@@ -35,7 +35,7 @@ public:
 	virtual ~L7Protocol();
 protected:
 	Network *net;
-	// This class must be new()ed and not fooled around
+	// This class must be make_ptr()ed, handed to Network and not fooled around
 	L7Protocol() = delete;
 	L7Protocol(const L7Protocol&) = delete;
 	L7Protocol(L7Protocol&&) = delete;
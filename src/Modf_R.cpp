@@ -15,8 +15,14 @@ Modf_R::Modf_R(Network *net): Modifier(net)
 
 Ptr<Packet> Modf_R::modify(const Packet& pkt)
 {
+	if (pkt.params().has("S")) {
+		// source-routed packet: we are the first listed hop, and
+		// the list becomes empty after the last hop
+		Params params = pkt.params();
+		params.put("S", RouteTable::rest_hops(params.get("S")));
+		params.put_naked("R");
+		return pkt.change_params(params);
+	}
 	// earmarks all forwarded packets
-	Params new_params = pkt.params();
-	new_params.put_naked("R");
-	return pkt.change_params(new_params);
+	return pkt.add_naked_param("R");
 }
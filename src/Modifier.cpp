@@ -26,8 +26,6 @@
 
 Modifier::Modifier(Network *net): net(net)
 {
-	// Network becomes the owner
-	net->add_modifier(this);
 }
 
 Modifier::~Modifier()
@@ -22,7 +22,7 @@ public:
 	virtual ~Modifier();
 protected:
 	Network *net;
-	// This class must be new()ed and not fooled around
+	// This class must be make_ptr()ed, handed to Network and not fooled around
 	Modifier() = delete;
 	Modifier(const Modifier&) = delete;
 	Modifier(Modifier&&) = delete;
@@ -56,6 +56,54 @@ void arduino_nvram_repeater_save(uint32_t r)
 	prefs.end();
 }
 
+uint32_t arduino_nvram_verify_relay_load()
+{
+	prefs.begin(chapter);
+	uint32_t r = prefs.getUInt("vrelay");
+	prefs.end();
+
+	return r;
+}
+
+void arduino_nvram_verify_relay_save(uint32_t r)
+{
+	prefs.begin(chapter, false);
+	prefs.putUInt("vrelay", r);
+	prefs.end();
+}
+
+uint32_t arduino_nvram_binary_header_load()
+{
+	prefs.begin(chapter);
+	uint32_t r = prefs.getUInt("binhdr");
+	prefs.end();
+
+	return r;
+}
+
+void arduino_nvram_binary_header_save(uint32_t r)
+{
+	prefs.begin(chapter, false);
+	prefs.putUInt("binhdr", r);
+	prefs.end();
+}
+
+uint32_t arduino_nvram_explicit_route_load()
+{
+	prefs.begin(chapter);
+	uint32_t r = prefs.getUInt("exroute");
+	prefs.end();
+
+	return r;
+}
+
+void arduino_nvram_explicit_route_save(uint32_t r)
+{
+	prefs.begin(chapter, false);
+	prefs.putUInt("exroute", r);
+	prefs.end();
+}
+
 uint32_t arduino_nvram_beacon_load()
 {
 	prefs.begin(chapter);
@@ -135,6 +183,54 @@ void arduino_nvram_hmac_psk_save(const Buffer &b)
 	HMACKeys::invalidate();
 }
 
+// Per-prefix HMAC keys (hashed), indexed by callsign prefix.
+// Stored as hk.n (count), hk.p<i> (prefix) and hk.k<i> (key).
+Dict<Buffer> arduino_nvram_hmac_keys_load()
+{
+	Dict<Buffer> keys;
+	prefs.begin(chapter);
+	uint32_t n = prefs.getUInt("hk.n");
+	for (uint32_t i = 0; i < n; ++i) {
+		char prefix[12];
+		char key[33];
+		// len includes \0
+		size_t plen = prefs.getString((Buffer("hk.p") + Buffer::itoa(i)).c_str(), prefix, 12);
+		size_t klen = prefs.getString((Buffer("hk.k") + Buffer::itoa(i)).c_str(), key, 33);
+		if (plen > 1 && klen > 1) {
+			keys.put(Buffer(prefix, plen - 1), Buffer(key, klen - 1));
+		}
+	}
+	prefs.end();
+	return keys;
+}
+
+// Add, replace or remove (if key is empty) the key of a prefix
+void arduino_nvram_hmac_key_save(const Buffer &prefix, const Buffer &b)
+{
+	Dict<Buffer> keys = arduino_nvram_hmac_keys_load();
+	if (b.empty()) {
+		keys.remove(prefix);
+	} else {
+		keys.put(prefix, HMACKeys::hash_key(b));
+	}
+
+	prefs.begin(chapter, false);
+	uint32_t old_n = prefs.getUInt("hk.n");
+	const Vector<Buffer>& prefixes = keys.keys();
+	for (size_t i = 0; i < prefixes.count(); ++i) {
+		prefs.putString((Buffer("hk.p") + Buffer::itoa(i)).c_str(), prefixes[i].c_str());
+		prefs.putString((Buffer("hk.k") + Buffer::itoa(i)).c_str(), keys[prefixes[i]].c_str());
+	}
+	// entries are compacted, remove the ones left over
+	for (uint32_t i = keys.count(); i < old_n; ++i) {
+		prefs.remove((Buffer("hk.p") + Buffer::itoa(i)).c_str());
+		prefs.remove((Buffer("hk.k") + Buffer::itoa(i)).c_str());
+	}
+	prefs.putUInt("hk.n", keys.count());
+	prefs.end();
+	HMACKeys::invalidate();
+}
+
 // used by Wi-Fi SSID and password
 void arduino_nvram_save(const char *key, const Buffer& value)
 {
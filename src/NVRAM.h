@@ -12,12 +12,22 @@
 #include "Pointer.h"
 #include "Packet.h"
 #include "Callsign.h"
+#include "Dict.h"
 
 void arduino_nvram_clear_all();
 
 uint32_t arduino_nvram_repeater_load();
 void arduino_nvram_repeater_save(uint32_t);
 
+uint32_t arduino_nvram_verify_relay_load();
+void arduino_nvram_verify_relay_save(uint32_t);
+
+uint32_t arduino_nvram_binary_header_load();
+void arduino_nvram_binary_header_save(uint32_t);
+
+uint32_t arduino_nvram_explicit_route_load();
+void arduino_nvram_explicit_route_save(uint32_t);
+
 uint32_t arduino_nvram_beacon_load();
 void arduino_nvram_beacon_save(uint32_t);
 
@@ -30,6 +40,9 @@ void arduino_nvram_callsign_save(const Callsign&);
 Buffer arduino_nvram_hmac_psk_load();
 void arduino_nvram_hmac_psk_save(const Buffer &b);
 
+Dict<Buffer> arduino_nvram_hmac_keys_load();
+void arduino_nvram_hmac_key_save(const Buffer &prefix, const Buffer &b);
+
 Buffer arduino_nvram_load(const char *);
 void arduino_nvram_save(const char *, const Buffer&);
 
@@ -16,17 +16,22 @@
 #include "Proto_Beacon.h"
 #include "Modf_R.h"
 #include "Proto_C.h"
+#include "Proto_Z.h"
+#include "Proto_F.h"
+#include "Proto_RS.h"
 #include "Proto_HMAC.h"
 #include "Proto_Rreq.h"
 #include "Proto_Switch.h"
 #include "Modf_Rreq.h"
 #include "Config.h"
 
-static const int64_t TX_BUSY_RETRY_TIME = 1 * SECONDS;
+static const int64_t TX_IDLE_TIME = 1 * MINUTES;
 
 static const int64_t NEIGH_PERSIST = 60 * MINUTES;
 static const int64_t NEIGH_CLEAN = 1 * MINUTES;
 
+static const int64_t ROUTE_PERSIST = 30 * MINUTES;
+
 static const int64_t RECV_LOG_PERSIST = 10 * MINUTES;
 static const int64_t RECV_LOG_CLEAN = 1 * MINUTES;
 
@@ -37,19 +42,32 @@ Peer::Peer(int rssi, int64_t timestamp):
 Peer::Peer()
 {}
 
-RecvLogItem::RecvLogItem(int rssi, int64_t timestamp):
-	rssi(rssi), timestamp(timestamp)
-{}
-
-RecvLogItem::RecvLogItem()
-{}
-
 // Generates a random number with average avg and spread 'fudge'
 uint32_t Network::fudge(uint32_t avg, double fudge)
 {
 	return arduino_random2(avg * (1.0 - fudge), avg * (1.0 + fudge));
 }
 
+/* Relay delay weighted by RSSI of the received packet. A weak signal
+   means the sender is far away, so relaying it extends coverage the
+   most: it goes sooner, and the other repeaters are more likely to
+   suppress their own relays (see overheard()). The weight goes from
+   RELAY_DELAY_NEAR_PCT at RELAY_RSSI_NEAR (or stronger) linearly down to
+   RELAY_DELAY_FAR_PCT at RELAY_RSSI_FAR (or weaker). */
+uint32_t Network::relay_backoff(uint32_t avg, int rssi)
+{
+	int pct;
+	if (rssi >= RELAY_RSSI_NEAR) {
+		pct = RELAY_DELAY_NEAR_PCT;
+	} else if (rssi <= RELAY_RSSI_FAR) {
+		pct = RELAY_DELAY_FAR_PCT;
+	} else {
+		pct = RELAY_DELAY_FAR_PCT + (RELAY_DELAY_NEAR_PCT - RELAY_DELAY_FAR_PCT)
+			* (rssi - RELAY_RSSI_FAR) / (RELAY_RSSI_NEAR - RELAY_RSSI_FAR);
+	}
+	return (uint64_t) avg * pct / 100;
+}
+
 // Generates a random string with safe characters (~5 bits per char)
 Buffer Network::gen_random_token(int len)
 {
@@ -64,39 +82,40 @@ Buffer Network::gen_random_token(int len)
 	return b;
 }
 
-// Packet transmission task.
+// Packet transmission task. There is only one, that sends frames
+// from the tx queue.
 class PacketTx: public Task {
 public:
-	PacketTx(Network* net, const Buffer& encoded_packet, int64_t offset): 
-			Task("tx", offset), net(net), encoded_packet(encoded_packet)
+	PacketTx(Network* net, int64_t offset):
+			Task("tx", offset), net(net)
 	{
 	}
 protected:
 	virtual int64_t run2(int64_t now) {
-		return net->tx(encoded_packet);
+		return net->tx_run(now);
 	}
 private:
 	Network *net;
-	const Buffer encoded_packet;
 };
 
 // Packet routing task.
 class PacketFwd: public Task {
 public:
-	PacketFwd(Network* net, const Ptr<Packet> packet, bool we_are_origin):
-		Task("fwd", 0), net(net), packet(packet), we_are_origin(we_are_origin)
+	PacketFwd(Network* net, Ptr<Packet> packet, bool we_are_origin):
+		Task("fwd", 0), net(net), packet(std::move(packet)), we_are_origin(we_are_origin)
 	{
 	}
 protected:
 	virtual int64_t run2(int64_t now)
 	{
-		net->route(packet, we_are_origin, now);
+		// one-off task, packet can be handed over
+		net->route(std::move(packet), we_are_origin, now);
 		// forces this task to be one-off
 		return 0;
 	}
 private:
 	Network *net;
-	const Ptr<Packet> packet;
+	Ptr<Packet> packet;
 	const bool we_are_origin;
 };
 
@@ -136,33 +155,49 @@ private:
 
 //////////////////////////// Network class proper
 
-Network::Network()
+Network::Network():
+	packet_pool("packet", sizeof(PtrPooled<Packet>), POOL_PACKETS),
+	fwd_pool("fwd", sizeof(PtrPooled<PacketFwd>), POOL_FWD_TASKS),
+	tx_airtime(TX_DUTY_CYCLE, TX_AIRTIME_BURST, sys_timestamp()),
+	txq(TX_QUEUE_SIZE),
+	tx_busy_until(0),
+	relays_queued(0),
+	relays_suppressed(0),
+	recv_log(RECV_LOG_PERSIST),
+	routes(ROUTE_TABLE_SIZE, ROUTE_PERSIST)
 {
 	my_callsign = arduino_nvram_callsign_load();
 	if (! my_callsign.is_valid()) return;
 	repeater_function_activated = arduino_nvram_repeater_load();
-	last_pkt_id = arduino_nvram_id_load();
+	verify_relays = arduino_nvram_verify_relay_load();
+	binary_header = arduino_nvram_binary_header_load();
+	explicit_routing = arduino_nvram_explicit_route_load();
 
 	// Periodic housecleaning tasks
-	schedule(new CleanRecvLogTask(this, RECV_LOG_CLEAN));
-	schedule(new CleanNeighTask(this, NEIGH_CLEAN));
+	schedule(make_ptr<CleanRecvLogTask>(this, RECV_LOG_CLEAN));
+	schedule(make_ptr<CleanNeighTask>(this, NEIGH_CLEAN));
+	tx_task = make_ptr<PacketTx>(this, TX_IDLE_TIME);
+	schedule(tx_task);
 
 	// Core L7 protocols
 	// (should come before others, since e.g. RREQ does not check HMAC)
-	new Proto_Beacon(this);
-	new Proto_Ping(this);
-	new Proto_Rreq(this);
+	add_l7protocol(make_ptr<Proto_Beacon>(this));
+	add_l7protocol(make_ptr<Proto_Ping>(this));
+	add_l7protocol(make_ptr<Proto_Rreq>(this));
 #ifdef SWITCH_PROTO_SUPPORT
-	new Proto_Switch(this);
+	add_l7protocol(make_ptr<Proto_Switch>(this));
 #endif
 
 	// Core L4 protocols
-	new Proto_HMAC(this); // must be the first to handle rx
-	new Proto_C(this);
+	add_l4protocol(make_ptr<Proto_HMAC>(this)); // must be the first to handle rx
+	add_l4protocol(make_ptr<Proto_F>(this)); // reassembles before others see the msg
+	add_l4protocol(make_ptr<Proto_C>(this));
+	add_l4protocol(make_ptr<Proto_Z>(this)); // compresses before HMAC signs
+	add_l4protocol(make_ptr<Proto_RS>(this)); // keeps msgs before compression
 
 	// Core L3 modifiers
-	new Modf_R(this);
-	new Modf_Rreq(this);
+	add_modifier(make_ptr<Modf_R>(this));
+	add_modifier(make_ptr<Modf_Rreq>(this));
 
 	transport = Ptr<LoRaL2>(new LoRaL2(BAND, SPREAD, BWIDTH, 0, 0, this));
 }
@@ -176,73 +211,86 @@ Network::~Network()
 	modifiers.clear();
 }
 
-// Add a protocol to stack. Called by Protocol class itself,
-// so it never has to be called explicitly when stantiating 
-// a protocol.
-void Network::add_l7protocol(L7Protocol* p)
+// Add a protocol to stack. Network becomes the owner.
+void Network::add_l7protocol(Ptr<L7Protocol> p)
 {
-	l7protocols.push_back(Ptr<L7Protocol>(p));
+	l7protocols.push_back(std::move(p));
 }
 
-void Network::add_l4protocol(L4Protocol* p)
+void Network::add_l4protocol(Ptr<L4Protocol> p)
 {
-	l4protocols.push_back(Ptr<L4Protocol>(p));
+	l4protocols.push_back(std::move(p));
 }
 
-// Add a modifier to stack. Called by Modifier class itself,
-// so it never has to be called explicitly when stantiating 
-// a protocol.
-void Network::add_modifier(Modifier * p)
+// Add a modifier to stack. Network becomes the owner.
+void Network::add_modifier(Ptr<Modifier> p)
 {
-	modifiers.push_back(Ptr<Modifier>(p));
-}
-
-// Gets next packet ID and saves to NVRAM
-size_t Network::get_next_pkt_id()
-{
-	if (++last_pkt_id > MAX_PACKET_ID) {
-		last_pkt_id = 1;
-	}
-	arduino_nvram_id_save(last_pkt_id);
-	return last_pkt_id;
+	modifiers.push_back(std::move(p));
 }
 
 size_t Network::get_last_pkt_id() const
 {
-	return last_pkt_id;
+	return pkt_id.last();
 }
 
 // Called from application layer to send a packet
 // (i.e. originate a packet)
 uint32_t Network::send(const Callsign &to, Params params, const Buffer& msg)
 {
-	uint32_t id = get_next_pkt_id();
+	uint32_t id = pkt_id.next();
 	params.set_ident(id);
-	Ptr<Packet> pkt(new Packet(to, me(), params, msg));
+	send_held(to, params, msg);
+	return id;
+}
+
+// Send a packet whose ID was already assigned by send(), e.g. one held
+// back by a L4 protocol and sent later under the ID the app was given
+void Network::send_held(const Callsign &to, Params params, const Buffer& msg)
+{
+	// Explicit routing, if enabled and the way is known (and did not
+	// fail lately): complete path found by RREQ, or else next hop.
+	// RREQ must always go by diffusion, it is the way to discover routes.
+	if (explicit_routing && ! to.is_q() && ! params.has("RREQ") && ! routes.failed(to)) {
+		Buffer sroute = routes.source_route(to);
+		Buffer via = routes.next_hop(me(), to);
+		if (! sroute.empty()) {
+			params.put("S", sroute);
+		} else if (! via.empty()) {
+			params.put("V", via);
+		}
+	}
+
+	Ptr<Packet> pkt = make_ptr<Packet>(to, me(), params, msg);
 
 	// handle L4 protocols, in reverse order of RX
 	for (size_t i = l4protocols.count(); i > 0; --i) {
 		auto response = l4protocols[i-1]->tx(*pkt);
+		if (response.hold) {
+			// protocol sends it later, e.g. when window opens
+			return;
+		}
 		if (response.pkt) {
 			// more than one L4 protocol can tweak the packet
-			pkt = response.pkt;
+			pkt = std::move(response.pkt);
 		}
 	}
 
 	// schedule radio routing/transmission
-	schedule(new PacketFwd(this, pkt, true));
-
-	return id;
+	schedule(make_ptr<PacketFwd>(this, std::move(pkt), true));
 }
 
 // Receive packet targeted to this station
 void Network::recv(Ptr<Packet> pkt)
 {
-	logs("Received pkt", pkt->encode_l3(max_payload()));
+	logs("Received pkt", pkt->encoded());
 
 	// handle L4 protocols
 	for (size_t i = 0; i < l4protocols.count(); ++i) {
 		auto response = l4protocols[i]->rx(*pkt);
+		if (response.pkt) {
+			// e.g. decoded message
+			pkt = std::move(response.pkt);
+		}
 		if (response.has_packet) {
 			send(response.to, response.params, response.msg);
 		}
@@ -250,6 +298,9 @@ void Network::recv(Ptr<Packet> pkt)
 			logs("L4 error", response.error_msg);
 			return;
 		}
+		if (response.hold) {
+			return;
+		}
 	}
 
 	// check if packet can be handled automatically by L7 protocol
@@ -274,37 +325,47 @@ void Network::recv(LoRaL2Packet *l2pkt)
 	}
 
 	int error;
-	Ptr<Packet> pkt = Packet::decode_l3((const char*) l2pkt->packet, l2pkt->len, l2pkt->rssi, error);
+	BufferView from;
+	uint32_t ident;
+	char from_buf[Callsign::MAX_LEN];
+	const char *data = (const char*) l2pkt->packet;
 
-	if (!pkt) {
+	// Validate in place and discard duplicates before decoding
+	if (! Packet::check_l3(data, l2pkt->len, from, ident, error, from_buf)) {
 		logi("rx invalid pkt err", error);
 		delete l2pkt;
 		return;
 	}
 
+	RecvLogItem* dup = recv_log.get(from, ident, sys_timestamp());
+	if (dup) {
+		overheard(*dup, Callsign::hash(from), ident);
+		delete l2pkt;
+		return;
+	}
+
+	Ptr<Packet> pkt = Packet::decode_l3(data, l2pkt->len, l2pkt->rssi, error, &packet_pool);
+	if (! pkt) {
+		logs("rx pkt dropped, pool exhausted:", packet_pool.name());
+		delete l2pkt;
+		return;
+	}
+
 	logi("rx good packet, RSSI =", l2pkt->rssi);
 	delete l2pkt;
 
-	schedule(new PacketFwd(this, pkt, false));
+	Ptr<Task> fwd = make_pooled_ptr<PacketFwd>(fwd_pool, this, std::move(pkt), false);
+	if (! fwd) {
+		logs("rx pkt dropped, pool exhausted:", fwd_pool.name());
+		return;
+	}
+	schedule(std::move(fwd));
 }
 
 // purge old packet IDs from recv log
 int64_t Network::clean_recv_log(int64_t now)
 {
-	Vector<Buffer> remove_list;
-
-	const Vector<Buffer>& keys = recv_log.keys();
-	for (size_t i = 0; i < keys.count(); ++i) {
-		if ((recv_log[keys[i]].timestamp + RECV_LOG_PERSIST) < now) {
-			remove_list.push_back(keys[i]);
-		}
-	}
-
-	for (size_t i = 0; i < remove_list.count(); ++i) {
-		recv_log.remove(remove_list[i]);
-		// logs("Forgotten packet", remove_list[i]);
-	}
-
+	recv_log.clean(now);
 	return RECV_LOG_CLEAN;
 }
 
@@ -356,6 +417,8 @@ int64_t Network::clean_neigh(int64_t now)
 	}
 	}
 
+	routes.expire(now);
+
 	return NEIGH_CLEAN;
 }
 
@@ -364,18 +427,198 @@ size_t Network::max_payload() const
 	return transport->max_payload();
 }
 
+// Memory pools, for statistics
+Vector<const Pool*> Network::pools() const
+{
+	Vector<const Pool*> v;
+	v.push_back(&packet_pool);
+	v.push_back(&fwd_pool);
+	return v;
+}
+
 // execute packet transmission
-int64_t Network::tx(const Buffer &encoded_packet)
+// Returns time to retry if the packet could not be sent now
+int64_t Network::tx(const Buffer &encoded_packet, int64_t now)
 {
 	// makes sure won't fail because of packet too big
 	Buffer trimmed_packet = encoded_packet.substr(0, max_payload());
+
+	// wait for airtime budget (duty cycle), the packet stays queued
+	int64_t airtime = Airtime::of(trimmed_packet.length(), transport->speed_bps());
+	int64_t wait = tx_airtime.wait_time(airtime, now);
+	if (wait > 0) {
+		return wait;
+	}
+
 	if (! transport->send((const uint8_t*) trimmed_packet.c_str(),
 				trimmed_packet.length())) {
-		return TX_BUSY_RETRY_TIME;
+		// channel busy, probably by a frame of similar size
+		return airtime;
 	}
+	tx_airtime.used(airtime, now);
+	tx_busy_until = now + airtime;
 	return 0;
 }
 
+// Send the next frame of tx queue. Returns when to run again.
+int64_t Network::tx_run(int64_t now)
+{
+	if (now < tx_busy_until) {
+		// radio still busy with the previous frame
+		return tx_busy_until - now;
+	}
+
+	size_t index;
+	int64_t wait;
+	if (! txq.next(now, index, wait)) {
+		return wait > 0 ? wait : TX_IDLE_TIME;
+	}
+
+	int64_t retry = tx(txq.frame(index), now);
+	if (retry > 0) {
+		return retry;
+	}
+	txq.remove(index);
+
+	// LoRaL2 does not notify when transmission is done, so
+	// we wake up at the estimated end of airtime
+	return tx_busy_until - now;
+}
+
+// Queue a frame for transmission, not before 'delay'
+bool Network::enqueue_tx(const Buffer& encoded_pkt, TxQueue::Priority prio,
+				int64_t delay, int64_t now, uint32_t key, uint32_t ident)
+{
+	if (! txq.push(encoded_pkt, prio, now + delay, key, ident)) {
+		return false;
+	}
+	wake_tx(now);
+	return true;
+}
+
+// Make sure the tx task runs as soon as the next frame is due
+void Network::wake_tx(int64_t now)
+{
+	size_t index;
+	int64_t wait;
+	if (txq.next(now, index, wait)) {
+		wait = 0;
+	} else if (wait < 0) {
+		return;
+	}
+	if (now + wait < tx_busy_until) {
+		wait = tx_busy_until - now;
+	}
+
+	if (tx_task && tx_task->next_run() <= (now + wait)) {
+		return;
+	}
+	if (tx_task) {
+		task_mgr.cancel(tx_task.id());
+	}
+	tx_task = make_ptr<PacketTx>(this, wait);
+	schedule(tx_task);
+}
+
+/* Counter-based flood suppression. A duplicate means that another
+   station has relayed the packet already. Once enough copies have been
+   heard, our pending relay would add little coverage, so it is
+   withdrawn from tx queue. */
+void Network::overheard(RecvLogItem& item, uint32_t key, uint32_t ident)
+{
+	if (item.dups < 255) {
+		++item.dups;
+	}
+	if (! RELAY_SUPPRESS_COUNT || item.dups < RELAY_SUPPRESS_COUNT) {
+		return;
+	}
+	if (txq.cancel(key, ident)) {
+		++relays_suppressed;
+		logi("relay suppressed, copies heard", item.dups);
+	}
+}
+
+// Relays queued, for statistics
+uint32_t Network::queued_relays() const
+{
+	return relays_queued;
+}
+
+// Relays withdrawn by flood suppression, for statistics
+uint32_t Network::suppressed_relays() const
+{
+	return relays_suppressed;
+}
+
+const TxQueue& Network::tx_queue() const
+{
+	return txq;
+}
+
+const Airtime& Network::airtime() const
+{
+	return tx_airtime;
+}
+
+/* Learn radio links from a received packet. A packet without R
+   was heard directly from its source. RREQ and RRSP packets carry the
+   list of hops they went through. (R does not tell which repeater
+   relayed the packet, so relayed packets tell nothing else.) */
+void Network::learn_routes(const Packet& pkt, int64_t now)
+{
+	const Params& params = pkt.params();
+	if (! params.has("R")) {
+		routes.add_edge(me(), pkt.from(), pkt.rssi(), now);
+	}
+	if (pkt.to().is_q()) {
+		return;
+	}
+	if (params.has("RREQ")) {
+		routes.add_path(pkt.from(), pkt.msg(), me(), pkt.rssi(), now);
+	} else if (params.has("RRSP")) {
+		// RRSP path starts at the RREQ originator
+		routes.add_path(pkt.to(), pkt.msg(), me(), pkt.rssi(), now);
+		if (me() == pkt.to()) {
+			// answer to our RREQ, keep the path
+			routes.add_source_route(pkt.msg(), now);
+		}
+	}
+}
+
+// Called by protocols when delivery through the known route seems to
+// have failed. Packets to 'to' go by diffusion for a while.
+void Network::route_failed(const Callsign& to)
+{
+	if (! explicit_routing || routes.failed(to)) {
+		return;
+	}
+	logs("route failed, using diffusion", to);
+	routes.fail(to, sys_timestamp());
+}
+
+// Known unicast routes, for information
+const Dict<RouteTable::Hop>& Network::route_hops()
+{
+	return routes.hops(me());
+}
+
+// Transmission priority of a packet
+static TxQueue::Priority tx_priority(const Packet& pkt, bool we_are_origin)
+{
+	// QB and QR beacons
+	if (pkt.to().is_reserved()) {
+		return TxQueue::BEACON;
+	}
+	if (! we_are_origin) {
+		return TxQueue::RELAY;
+	}
+	const Params& params = pkt.params();
+	if (params.has("PONG") || params.has("RRSP") || params.has("CO")) {
+		return TxQueue::CONTROL;
+	}
+	return TxQueue::LOCAL;
+}
+
 /* Update neighbor and peer lists based on a packet that
    was sent to us, either unicast or QB/QR/QC */
 void Network::update_peerlist(int64_t now, const Ptr<Packet> &pkt)
@@ -413,10 +656,14 @@ void Network::route(Ptr<Packet> pkt, bool we_are_origin, int64_t now)
 		}
 
 		// Annotate to detect duplicates
-		recv_log[pkt->signature()] = RecvLogItem(pkt->rssi(), now);
+		recv_log.put(pkt->from(), pkt->params().ident(),
+				RecvLogItem(pkt->rssi(), now));
 		// Transmit
-		schedule(new PacketTx(this, pkt->encode_l3(max_payload()), 1));
-		logs("tx ", pkt->encode_l3(max_payload()));
+		Buffer encoded_pkt = pkt->encode_l3(max_payload(), binary_header);
+		logs("tx ", pkt->encoded());
+		if (! enqueue_tx(encoded_pkt, tx_priority(*pkt, true), 0, now)) {
+			logs("tx dropped, queue full", pkt->signature());
+		}
 		return;
 	}
 
@@ -427,11 +674,15 @@ void Network::route(Ptr<Packet> pkt, bool we_are_origin, int64_t now)
 	}
 
 	// Discard received duplicates
-	if (recv_log.has(pkt->signature())) {
+	RecvLogItem* dup = recv_log.get(pkt->from(), pkt->params().ident(), now);
+	if (dup) {
 		// logs("pkt dup", pkt->signature());
+		overheard(*dup, pkt->from().hash(), pkt->params().ident());
 		return;
 	}
-	recv_log[pkt->signature()] = RecvLogItem(pkt->rssi(), now);
+	recv_log.put(pkt->from(), pkt->params().ident(),
+			RecvLogItem(pkt->rssi(), now));
+	learn_routes(*pkt, now);
 
 	if (me() == pkt->to()) {
 		// We are the sole final destination
@@ -451,6 +702,38 @@ void Network::route(Ptr<Packet> pkt, bool we_are_origin, int64_t now)
 		return;
 	}
 
+	// Optionally, do not spend airtime relaying forged packets.
+	// Verification outcome is shared with local delivery via recv log.
+	if (verify_relays && Proto_HMAC_verify(this, *pkt).error) {
+		logs("relay dropped, bad HMAC", pkt->signature());
+		return;
+	}
+
+	// Relayed in the same format it was received
+	bool binary = pkt->binary();
+
+	// Source routing: only the next listed hop relays.
+	// Modf_R removes us from the list.
+	if (pkt->params().has("S")) {
+		if (! (me() == RouteTable::first_hop(pkt->params().get("S")))) {
+			return;
+		}
+	} else if (pkt->params().has("V")) {
+		// Explicit routing: only the chosen next hop relays.
+		if (! (me() == pkt->params().get("V"))) {
+			return;
+		}
+		Params params = pkt->params();
+		Buffer via = routes.next_hop(me(), pkt->to());
+		if (via.empty()) {
+			// no route from here, resort to diffusion
+			params.remove("V");
+		} else {
+			params.put("V", via);
+		}
+		pkt = pkt->change_params(params);
+	}
+
 	bool already_repeated = pkt->params().has("R");
 
 	// Forward packet modifiers
@@ -458,31 +741,44 @@ void Network::route(Ptr<Packet> pkt, bool we_are_origin, int64_t now)
 	for (size_t i = 0; i < modifiers.count(); ++i) {
 		auto modified_pkt = modifiers[i]->modify(*pkt);
 		if (modified_pkt) {
-			pkt = modified_pkt;
+			pkt = std::move(modified_pkt);
 		}
 	}
 
-	Buffer encoded_pkt = pkt->encode_l3(max_payload());
+	Buffer encoded_pkt = pkt->encode_l3(max_payload(), binary);
 
-	// Average TX delay: 2.5x the packet airtime
-	// spread from 0 to 5x to mitigate collision in the case of multiple repeaters
+	// Average TX delay: 2.5x the packet airtime, weighted by RSSI (from
+	// 1.25x to 3.75x with default config). Random spread from 0.05x to
+	// 1.95x of the weighted average (so up to ~7.5x the airtime) mitigates
+	// collision in the case of multiple repeaters.
 	double packet_len = SECONDS * encoded_pkt.length() * 8
 				/ transport->speed_bps();
-	int64_t delay = Network::fudge(packet_len * 2.5, 0.95);
+	int64_t delay = Network::fudge(relay_backoff(packet_len * 2.5, pkt->rssi()), 0.95);
 	// Packets already repeated: additional window to mitigate collision from
 	// additional repeaters of the last hop
 	if (already_repeated) {
 		delay += packet_len * 5;
 	}
 
+	if (! enqueue_tx(encoded_pkt, tx_priority(*pkt, false), delay, now,
+				pkt->from().hash(), pkt->params().ident())) {
+		logs("relay dropped, tx queue full", pkt->signature());
+		return;
+	}
+	++relays_queued;
 	logi("relaying w/ delay", delay);
-	schedule(new PacketTx(this, encoded_pkt, delay));
 }
 
 // Schedule a Task. Run later via run_tasks().
-void Network::schedule(Task *task)
+void Network::schedule(Ptr<Task> task)
 {
-	task_mgr.schedule(Ptr<Task>(task));
+	task_mgr.schedule(std::move(task));
+}
+
+// Remove a pending Task, e.g. to schedule it earlier
+void Network::cancel(const Task* task)
+{
+	task_mgr.cancel(task);
 }
 
 // Run pending tasks. Called by system may loop.
@@ -491,7 +787,15 @@ void Network::run_tasks(int64_t millis)
 	task_mgr.run(millis);
 }
 
-Callsign Network::me() const {
+// Time until the next pending task, so the main loop may sleep.
+// A packet received from radio schedules a task with no delay,
+// so pending rx work shows up here as 0.
+int64_t Network::idle_time(int64_t now) const
+{
+	return task_mgr.next_deadline(now);
+}
+
+const Callsign& Network::me() const {
 	return my_callsign;
 }
 
@@ -535,7 +839,13 @@ Dict<Peer>& Network::_peers()
 }
 
 /* For testing purposes only! */
-Dict<RecvLogItem>& Network::_recv_log()
+// Recv log entry of a received packet, 0 if not found
+RecvLogItem* Network::recv_log_item(const Packet& pkt)
+{
+	return recv_log.get(pkt.from(), pkt.params().ident(), sys_timestamp());
+}
+
+RecvLog& Network::_recv_log()
 {
 	return recv_log;
 }
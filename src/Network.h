@@ -15,10 +15,14 @@
 #include "Task.h"
 #include "Params.h"
 #include "Callsign.h"
+#include "RecvLog.h"
+#include "Pool.h"
+#include "PacketId.h"
+#include "Airtime.h"
+#include "TxQueue.h"
+#include "RouteTable.h"
 #include "LoRaL2/LoRaL2.h"
 
-#define MAX_PACKET_ID 9999
-
 class L7Protocol;
 class L4Protocol;
 class Modifier;
@@ -31,44 +35,49 @@ struct Peer {
 	int64_t timestamp;
 };
 
-struct RecvLogItem {
-	RecvLogItem(int rssi, int64_t timestamp);
-	RecvLogItem();
-	int rssi;
-	int64_t timestamp;
-};
-
 class Network: public LoRaL2Observer {
 public:
 	Network();
 	virtual ~Network();
 
-	Callsign me() const;
+	const Callsign& me() const;
 	bool am_i_repeater() const;
 	uint32_t send(const Callsign &to, Params params, const Buffer& msg);
 	void run_tasks(int64_t);
+	int64_t idle_time(int64_t) const;
 	const Dict<Peer>& neighbors() const;
 	const Dict<Peer>& repeaters() const;
 	const Dict<Peer>& peers() const;
 	static uint32_t fudge(uint32_t avg, double fudge);
+	static uint32_t relay_backoff(uint32_t avg, int rssi);
 	static Buffer gen_random_token(int);
 	size_t max_payload() const;
+	Vector<const Pool*> pools() const;
+	const Airtime& airtime() const;
+	const TxQueue& tx_queue() const;
+	uint32_t queued_relays() const;
+	const Dict<RouteTable::Hop>& route_hops();
+	uint32_t suppressed_relays() const;
 
 	// publicised to bridge with uncoupled code
 	virtual void recv(LoRaL2Packet *);
 	size_t get_last_pkt_id() const;
 
 	// publicised to be called by protocols
-	void schedule(Task*);
+	void send_held(const Callsign &to, Params params, const Buffer& msg);
+	void schedule(Ptr<Task>);
+	void cancel(const Task*);
+	void route_failed(const Callsign& to);
+	RecvLogItem* recv_log_item(const Packet&);
 
-	// Called by each Protocol or Modifier subclass constructor.
-	// Never call this yourself.
-	void add_l7protocol(L7Protocol*);
-	void add_l4protocol(L4Protocol*);
-	void add_modifier(Modifier*);
+	// Network becomes the owner of protocols and modifiers
+	void add_l7protocol(Ptr<L7Protocol>);
+	void add_l4protocol(Ptr<L4Protocol>);
+	void add_modifier(Ptr<Modifier>);
 
 	// publicised to be called by Tasks
-	int64_t tx(const Buffer&);
+	int64_t tx(const Buffer&, int64_t);
+	int64_t tx_run(int64_t);
 	void route(Ptr<Packet>, bool, int64_t);
 	int64_t clean_recv_log(int64_t);
 	int64_t clean_neigh(int64_t);
@@ -78,23 +87,41 @@ public:
 	Dict<Peer>& _neighbors();
 	Dict<Peer>& _repeaters();
 	Dict<Peer>& _peers();
-	Dict<RecvLogItem>& _recv_log();
+	RecvLog& _recv_log();
 
 private:
 	void recv(Ptr<Packet> pkt);
-	size_t get_next_pkt_id();
 	void update_peerlist(int64_t, const Ptr<Packet> &);
+	bool enqueue_tx(const Buffer&, TxQueue::Priority, int64_t, int64_t,
+			uint32_t key = 0, uint32_t ident = 0);
+	void overheard(RecvLogItem&, uint32_t, uint32_t);
+	void learn_routes(const Packet&, int64_t);
+	void wake_tx(int64_t);
+
+	// Pools come first, so they are destroyed after every pooled object
+	Pool packet_pool;
+	Pool fwd_pool;
 
 	Callsign my_callsign;
 	uint32_t repeater_function_activated;
-
+	uint32_t verify_relays;
+	uint32_t binary_header;
+	uint32_t explicit_routing;
+
+	Airtime tx_airtime;
+	TxQueue txq;
+	Ptr<Task> tx_task;
+	int64_t tx_busy_until;
+	uint32_t relays_queued;
+	uint32_t relays_suppressed;
 	Ptr<LoRaL2> transport;
 	TaskManager task_mgr;
 	Dict<Peer> neigh;
 	Dict<Peer> reptr;
 	Dict<Peer> peerlist;
-	Dict<RecvLogItem> recv_log;
-	size_t last_pkt_id;
+	RecvLog recv_log;
+	RouteTable routes;
+	PacketId pkt_id;
 	Vector< Ptr<L7Protocol> > l7protocols;
 	Vector< Ptr<L4Protocol> > l4protocols;
 	Vector< Ptr<Modifier> > modifiers;
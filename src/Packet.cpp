@@ -12,12 +12,25 @@
 #include "Packet.h"
 #include "Params.h"
 
-// Decode packet preamble (except callsigns).
-static bool decode_preamble(const char* data, size_t len,
-		Callsign &to, Callsign &from, Params& params, int& error)
+// Split packet into preamble fields and message, and validate them
+// in place. Nothing is copied.
+static bool split_l3(const char* data, size_t len,
+		BufferView &to, BufferView &from, BufferView &sparams,
+		BufferView &msg, uint32_t &ident, int& error)
 {
-	const char *d1 = (const char*) memchr(data, '<', len);
-	const char *d2 = (const char*) memchr(data, ':', len);
+	BufferView packet(data, len);
+	BufferView preamble = packet;
+	msg = BufferView();
+
+	const char *msgd = packet.find(' ');
+	if (msgd) {
+		preamble = packet.substr(0, msgd - data);
+		msg = packet.substr(preamble.length() + 1, len);
+	}
+	// else, valid packet with no message
+
+	const char *d1 = preamble.find('<');
+	const char *d2 = preamble.find(':');
 
 	if (d1 == 0 || d2 == 0) {
 		error = 100;
@@ -27,29 +40,276 @@ static bool decode_preamble(const char* data, size_t len,
 		return false;
 	}
 
-	to = Callsign(Buffer(data, d1 - data));
-	from = Callsign(Buffer(d1 + 1, d2 - d1 - 1));
+	to = preamble.substr(0, d1 - data);
+	from = preamble.substr(d1 - data + 1, d2 - d1 - 1);
+
+	if (!Callsign::check(to) || !Callsign::check(from)) {
+		error = 104;
+		return false;
+	}
+
+	sparams = preamble.substr(d2 - data + 1, preamble.length());
+
+	if (! Params::check(sparams, ident) || ! ident) {
+		error = 105;
+		return false;
+	}
+
+	return true;
+}
+
+/* Binary header format. Same contents as the text preamble, packed:
+ *
+ * marker 0x80 (a text packet always starts with a letter)
+ * to, from: 6-bit symbols, each callsign ends with a nil symbol
+ *	unless it has the maximum length; padded to byte boundary
+ * ident: varint, 7 bits per octet, LSB first
+ * params: sequence of one-byte codes, ended by BIN_END
+ * message: the rest of the packet, as is
+ */
+
+static const uint8_t BIN_MARKER = 0x80;
+
+enum {
+	BIN_END = 0,
+	// 1..BIN_NAKED_COUNT-1: well-known naked params
+	BIN_HMAC = 0x20,	// followed by 6 octets
+	BIN_GENERIC = 0x21,	// followed by length and KEY[=VALUE] as text
+};
+
+static const char *bin_naked[] = {
+	"", "R", "C", "CO", "PING", "PONG", "RREQ", "RRSP", "SW", "SWC",
+};
+static const size_t BIN_NAKED_COUNT = sizeof(bin_naked) / sizeof(bin_naked[0]);
+
+static const char *bin_symbols = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789-";
+
+static const char *hex_digits = "0123456789abcdef";
+
+static int hex_value(char c)
+{
+	const char *p = strchr(hex_digits, c);
+	return (p && c) ? (p - hex_digits) : -1;
+}
+
+// Appends 6-bit symbols to a buffer, MSB first
+class BitWriter {
+public:
+	explicit BitWriter(Buffer& out): out(out), acc(0), bits(0) {}
+	void put(uint8_t symbol)
+	{
+		acc = (acc << 6) | symbol;
+		bits += 6;
+		if (bits >= 8) {
+			bits -= 8;
+			out += (char) (acc >> bits);
+			acc &= (1 << bits) - 1;
+		}
+	}
+	void flush()
+	{
+		if (bits) {
+			out += (char) (acc << (8 - bits));
+			acc = bits = 0;
+		}
+	}
+private:
+	Buffer& out;
+	uint32_t acc;
+	uint32_t bits;
+};
+
+class BitReader {
+public:
+	BitReader(const uint8_t* data, size_t len, size_t pos):
+		data(data), len(len), pos(pos), acc(0), bits(0) {}
+	bool get(uint8_t& symbol)
+	{
+		if (bits < 6) {
+			if (pos >= len) {
+				return false;
+			}
+			acc = (acc << 8) | data[pos++];
+			bits += 8;
+		}
+		bits -= 6;
+		symbol = (acc >> bits) & 0x3f;
+		acc &= (1 << bits) - 1;
+		return true;
+	}
+	// Position of the first octet not consumed, padding discarded
+	size_t end() const
+	{
+		return pos;
+	}
+private:
+	const uint8_t* data;
+	size_t len;
+	size_t pos;
+	uint32_t acc;
+	uint32_t bits;
+};
+
+static bool pack_callsign(BitWriter& w, const Callsign& c)
+{
+	const char *s = c.c_str();
+	for (size_t i = 0; i < c.length(); ++i) {
+		const char *symbol = strchr(bin_symbols, s[i]);
+		if (! symbol || ! s[i]) {
+			return false;
+		}
+		w.put(symbol - bin_symbols + 1);
+	}
+	if (c.length() < Callsign::MAX_LEN) {
+		w.put(0);
+	}
+	return true;
+}
+
+// Unpacks a callsign into buf (Callsign::MAX_LEN octets), no validation
+static bool unpack_callsign(BitReader& r, char *buf, size_t& len)
+{
+	for (len = 0; len < Callsign::MAX_LEN; ++len) {
+		uint8_t symbol;
+		if (! r.get(symbol)) {
+			return false;
+		}
+		if (symbol == 0) {
+			break;
+		}
+		if (symbol > strlen(bin_symbols)) {
+			return false;
+		}
+		buf[len] = bin_symbols[symbol - 1];
+	}
+	return true;
+}
+
+// Walk the binary param list, validating it. If sparams is given,
+// the params are appended to it in text form.
+static bool walk_bin_params(const uint8_t* d, size_t len, size_t& pos, Buffer* sparams)
+{
+	while (pos < len) {
+		uint8_t code = d[pos++];
+		if (code == BIN_END) {
+			return true;
+		} else if (code < BIN_NAKED_COUNT) {
+			if (sparams) {
+				*sparams += ',';
+				*sparams += bin_naked[code];
+			}
+		} else if (code == BIN_HMAC) {
+			if ((pos + 6) > len) {
+				return false;
+			}
+			if (sparams) {
+				*sparams += ",H=";
+				for (size_t i = 0; i < 6; ++i) {
+					*sparams += hex_digits[d[pos + i] >> 4];
+					*sparams += hex_digits[d[pos + i] & 0xf];
+				}
+			}
+			pos += 6;
+		} else if (code == BIN_GENERIC) {
+			if (pos >= len || (pos + 1 + d[pos]) > len) {
+				return false;
+			}
+			BufferView item((const char*) d + pos + 1, d[pos]);
+			pos += 1 + d[pos];
+			// must be a single KEY or KEY=VALUE, not an ident
+			uint32_t ident;
+			char c = item.empty() ? 0 : item[0];
+			if (! ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))
+					|| item.find(',')
+					|| ! Params::check(item, ident)) {
+				return false;
+			}
+			if (sparams) {
+				*sparams += ',';
+				sparams->append(item.data(), item.length());
+			}
+		} else {
+			return false;
+		}
+	}
+	// no BIN_END
+	return false;
+}
+
+// Binary counterpart of split_l3(). Callsigns are unpacked into
+// to_buf and from_buf; params are converted to text if sparams is given.
+static bool split_l3_binary(const char* data, size_t len,
+		char *to_buf, BufferView &to, char *from_buf, BufferView &from,
+		Buffer *sparams, BufferView &msg, uint32_t &ident, int& error)
+{
+	const uint8_t *d = (const uint8_t*) data;
+	size_t to_len;
+	size_t from_len;
+
+	BitReader r(d, len, 1);
+	if (! unpack_callsign(r, to_buf, to_len) || ! unpack_callsign(r, from_buf, from_len)) {
+		error = 100;
+		return false;
+	}
+	to = BufferView(to_buf, to_len);
+	from = BufferView(from_buf, from_len);
 
-	if (!to.is_valid() || !from.is_valid()) {
+	if (!Callsign::check(to) || !Callsign::check(from)) {
 		error = 104;
 		return false;
 	}
 
-	const char *sparams = d2 + 1;
-	size_t sparams_len = len - (d2 - data) - 1;
-	params = Params(Buffer(sparams, sparams_len));
+	size_t pos = r.end();
+	ident = 0;
+	for (size_t shift = 0; ; shift += 7) {
+		if (pos >= len || shift > 14) {
+			error = 105;
+			return false;
+		}
+		uint8_t octet = d[pos++];
+		ident |= (uint32_t) (octet & 0x7f) << shift;
+		if (! (octet & 0x80)) {
+			break;
+		}
+	}
+	if (ident < 1 || ident > 999999) {
+		error = 105;
+		return false;
+	}
 
-	if (! params.is_valid_with_ident()) {
+	if (sparams) {
+		*sparams = Buffer::itoa(ident);
+	}
+	if (! walk_bin_params(d, len, pos, sparams)) {
 		error = 105;
 		return false;
 	}
 
+	msg = BufferView(data + pos, len - pos);
 	return true;
 }
 
+static bool is_binary(const char *data, size_t len)
+{
+	return len > 0 && (uint8_t) data[0] == BIN_MARKER;
+}
+
 Packet::Packet(const Callsign &to, const Callsign &from,
 			const Params& params, const Buffer& msg, int rssi): 
 			_to(to), _from(from), _params(params), _msg(msg), _rssi(rssi)
+{
+	_signature = Buffer(_from) + ":" + params.s_ident();
+	_preamble_len = 0;
+	_binary = false;
+}
+
+// Packet whose wire form is already known (received, or spliced from
+// another packet's wire form)
+Packet::Packet(const Callsign &to, const Callsign &from,
+			const Params& params, const Buffer& msg, int rssi,
+			const Buffer& encoded, size_t preamble_len):
+			_to(to), _from(from), _params(params), _msg(msg), _rssi(rssi),
+			_encoded(encoded), _preamble_len(preamble_len), _binary(false)
 {
 	_signature = Buffer(_from) + ":" + params.s_ident();
 }
@@ -63,66 +323,245 @@ Ptr<Packet> Packet::decode_l3_test(const char* data, int& error)
 	return decode_l3(data, strlen(data), -50, error);
 }
 
-// Decode packet coming from layer 2.
-Ptr<Packet> Packet::decode_l3(const char* data, size_t len, int rssi, int &error)
+// Validate packet coming from layer 2 without decoding it. Returns the
+// source callsign (as a view into data) and the packet ID, so the caller
+// may discard duplicates before paying for a full decode. The callsign
+// of a binary packet is unpacked into from_buf (Callsign::MAX_LEN octets)
+// and binary packets are rejected if it is not given.
+bool Packet::check_l3(const char* data, size_t len, BufferView& from, uint32_t& ident,
+			int &error, char *from_buf)
 {
-	const char *preamble = 0;
-	const char *msg = 0;
-	size_t preamble_len = 0;
-	size_t msg_len = 0;
-
-	const char *msgd = (const char*) memchr(data, ' ', len);
-	
-	if (msgd) {
-		preamble = data;
-		preamble_len = msgd - data;
-		msg = msgd + 1;
-		msg_len = len - preamble_len - 1;
-	} else {
-		// valid packet with no message
-		preamble = data;
-		preamble_len = len;
+	BufferView to;
+	BufferView sparams;
+	BufferView msg;
+	if (is_binary(data, len)) {
+		char to_buf[Callsign::MAX_LEN];
+		if (! from_buf) {
+			error = 100;
+			return false;
+		}
+		return split_l3_binary(data, len, to_buf, to, from_buf, from, 0, msg, ident, error);
 	}
+	return split_l3(data, len, to, from, sparams, msg, ident, error);
+}
 
-	Callsign to;
-	Callsign from;
-	Params params;
+// Decode packet coming from layer 2. If pool is given, the packet is
+// allocated from it, and decoding fails if the pool is exhausted.
+// Both text and binary formats are accepted.
+Ptr<Packet> Packet::decode_l3(const char* data, size_t len, int rssi, int &error, Pool* pool)
+{
+	BufferView to;
+	BufferView from;
+	BufferView sparams;
+	BufferView msg;
+	uint32_t ident;
 
-	if (! decode_preamble(preamble, preamble_len, to, from, params, error)) {
+	if (is_binary(data, len)) {
+		char to_buf[Callsign::MAX_LEN];
+		char from_buf[Callsign::MAX_LEN];
+		Buffer bparams;
+		if (! split_l3_binary(data, len, to_buf, to, from_buf, from, &bparams,
+					msg, ident, error)) {
+			return Ptr<Packet>(0);
+		}
+		// text wire form is generated on demand
+		Ptr<Packet> p;
+		if (! pool) {
+			p = make_ptr<Packet>(Callsign(to), Callsign(from), Params(bparams),
+					msg.str(), rssi, Buffer(), 0);
+		} else {
+			p = make_pooled_ptr<Packet>(*pool, Callsign(to), Callsign(from),
+					Params(bparams), msg.str(), rssi, Buffer(), 0);
+		}
+		if (! p) {
+			error = 106;
+			return p;
+		}
+		p->_binary = true;
+		return p;
+	}
+
+	if (! split_l3(data, len, to, from, sparams, msg, ident, error)) {
 		return Ptr<Packet>(0);
 	}
 
-	Ptr<Packet> p = Ptr<Packet>(new Packet(to, from, params, Buffer(msg, msg_len), rssi));
+	// Packet is valid, copy it out, keeping the original bytes
+	size_t preamble_len = sparams.data() + sparams.length() - data;
+	if (! pool) {
+		return make_ptr<Packet>(Callsign(to), Callsign(from), Params(sparams), msg.str(),
+				rssi, Buffer(data, len), preamble_len);
+	}
+
+	Ptr<Packet> p = make_pooled_ptr<Packet>(*pool, Callsign(to), Callsign(from),
+				Params(sparams), msg.str(), rssi, Buffer(data, len), preamble_len);
+	if (! p) {
+		error = 106;
+	}
 	return p;
 }
 
 // Generate a new packet, based on present packet, with modified message.
+// The preamble is reused from the present packet's wire form.
+// Derived packets keep the RSSI of the present packet.
 Ptr<Packet> Packet::change_msg(const Buffer& msg) const
 {
-	return Ptr<Packet>(new Packet(this->to(), this->from(), this->params(), msg));
+	const Buffer& enc = encoded();
+	Buffer new_enc;
+	new_enc.reserve(_preamble_len + 1 + msg.length());
+	new_enc.append(enc.c_str(), _preamble_len);
+	new_enc += ' ';
+	new_enc += msg;
+	return make_ptr<Packet>(this->to(), this->from(), this->params(), msg, _rssi,
+				new_enc, _preamble_len);
 }
 
 // Generate a new packet, based on present packet, with modified parameters.
 Ptr<Packet> Packet::change_params(const Params&new_params) const
 {
-	return Ptr<Packet>(new Packet(this->to(), this->from(), new_params, this->msg()));
+	return make_ptr<Packet>(this->to(), this->from(), new_params, this->msg(), _rssi);
 }
 
-// Encode a packet in layer 3.
-Buffer Packet::encode_l3(size_t max) const
+// Generate a new packet, based on present packet, with an additional naked
+// parameter. The new parameter is spliced into the present wire form.
+Ptr<Packet> Packet::add_naked_param(const char *key) const
 {
-	Buffer b(_to);
-	b += '<';
-	b += _from;
-	b += ':';
-	b += _params.serialized();
-	b += ' ';
-	b += _msg;
-	b = b.substr(0, max);
+	Params new_params = _params;
+	new_params.put_naked(key);
+	if (_params.has(key)) {
+		// key=value becomes naked, cannot splice
+		return change_params(new_params);
+	}
+
+	Buffer ukey(key);
+	ukey.uppercase();
+
+	const Buffer& enc = encoded();
+	Buffer new_enc;
+	new_enc.reserve(enc.length() + 1 + ukey.length());
+	new_enc.append(enc.c_str(), _preamble_len);
+	if (enc.charAt(_preamble_len - 1) != ',') {
+		new_enc += ',';
+	}
+	new_enc += ukey;
+	new_enc.append(enc.c_str() + _preamble_len, enc.length() - _preamble_len);
 
+	return make_ptr<Packet>(this->to(), this->from(), new_params, this->msg(), _rssi,
+				new_enc, new_enc.length() - (enc.length() - _preamble_len));
+}
+
+// Full layer-3 wire form of the packet. Encoded once and cached,
+// since the packet is immutable. For received packets, these are
+// the original bytes.
+const Buffer& Packet::encoded() const
+{
+	if (_encoded.empty()) {
+		Buffer sparams = _params.serialized();
+		_encoded.reserve(Callsign::MAX_LEN * 2 + 3 + sparams.length() + _msg.length());
+		_encoded += _to;
+		_encoded += '<';
+		_encoded += _from;
+		_encoded += ':';
+		_encoded += sparams;
+		_preamble_len = _encoded.length();
+		_encoded += ' ';
+		_encoded += _msg;
+	}
+	return _encoded;
+}
+
+// Binary wire form of the packet. Returns an empty buffer if
+// some param cannot be represented.
+Buffer Packet::encoded_binary() const
+{
+	Buffer b;
+	b.reserve(Callsign::MAX_LEN * 2 + 32 + _msg.length());
+	b += (char) BIN_MARKER;
+
+	BitWriter w(b);
+	if (! pack_callsign(w, _to) || ! pack_callsign(w, _from)) {
+		return Buffer();
+	}
+	w.flush();
+
+	uint32_t ident = _params.ident();
+	while (ident >= 0x80) {
+		b += (char) (0x80 | (ident & 0x7f));
+		ident >>= 7;
+	}
+	b += (char) ident;
+
+	Vector<Buffer> keys = _params.keys();
+	for (size_t i = 0; i < keys.count(); ++i) {
+		const Buffer& key = keys[i];
+		bool naked = _params.is_key_naked(key.c_str());
+		Buffer value = naked ? Buffer() : _params.get(key.c_str());
+
+		uint8_t code = 0;
+		for (size_t j = 1; naked && j < BIN_NAKED_COUNT; ++j) {
+			if (key == bin_naked[j]) {
+				code = j;
+				break;
+			}
+		}
+		if (code) {
+			b += (char) code;
+			continue;
+		}
+
+		if (key == "H" && value.length() == 12) {
+			char octets[6];
+			bool hex = true;
+			for (size_t j = 0; j < 6; ++j) {
+				int hi = hex_value(value.charAt(j * 2));
+				int lo = hex_value(value.charAt(j * 2 + 1));
+				if (hi < 0 || lo < 0) {
+					hex = false;
+					break;
+				}
+				octets[j] = (hi << 4) | lo;
+			}
+			if (hex) {
+				b += (char) BIN_HMAC;
+				b.append(octets, 6);
+				continue;
+			}
+		}
+
+		Buffer item = naked ? key : (key + "=" + value);
+		if (item.length() > 255) {
+			return Buffer();
+		}
+		b += (char) BIN_GENERIC;
+		b += (char) item.length();
+		b += item;
+	}
+	b += (char) BIN_END;
+
+	b += _msg;
 	return b;
 }
 
+// Encode a packet in layer 3, in text or binary format. Falls back
+// to text if the packet cannot be encoded in binary.
+Buffer Packet::encode_l3(size_t max, bool binary) const
+{
+	Buffer bb;
+	if (binary) {
+		bb = encoded_binary();
+	}
+	const Buffer& b = bb.empty() ? encoded() : bb;
+	if (b.length() <= max) {
+		return b;
+	}
+	return b.substr(0, max);
+}
+
+// Whether the packet was received in binary format
+bool Packet::binary() const
+{
+	return _binary;
+}
+
 // Packet unique identification (prefix + ID).
 Buffer Packet::signature() const
 {
@@ -130,25 +569,25 @@ Buffer Packet::signature() const
 }
 
 // Returns destination callsign of this packet.
-Callsign Packet::to() const
+const Callsign& Packet::to() const
 {
 	return _to;
 }
 
 // Returns source callsign
-Callsign Packet::from() const
+const Callsign& Packet::from() const
 {
 	return _from;
 }
 
 // returns parameters of this packet
-const Params Packet::params() const
+const Params& Packet::params() const
 {
 	return _params;
 }
 
 // returns the message or payload of this packet.
-const Buffer Packet::msg() const
+const Buffer& Packet::msg() const
 {
 	return _msg;
 }
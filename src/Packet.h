@@ -11,7 +11,9 @@
 
 #include "Vector.h"
 #include "Buffer.h"
+#include "BufferView.h"
 #include "Pointer.h"
+#include "Pool.h"
 #include "Callsign.h"
 #include "Params.h"
 
@@ -22,8 +24,11 @@ public:
 	~Packet();
 
 	/* next 2 are public for unit testing */
-	static Ptr<Packet> decode_l3(const char* data, size_t len, int rssi, int& error);
+	static Ptr<Packet> decode_l3(const char* data, size_t len, int rssi, int& error,
+				Pool* pool = 0);
 	static Ptr<Packet> decode_l3_test(const char *data, int& error);
+	static bool check_l3(const char* data, size_t len, BufferView& from,
+				uint32_t& ident, int& error, char* from_buf = 0);
 
 	Packet(const Packet &) = delete;
 	Packet(Packet &&) = delete;
@@ -33,21 +38,36 @@ public:
 
 	Ptr<Packet> change_msg(const Buffer&) const;
 	Ptr<Packet> change_params(const Params&) const;
-	Buffer encode_l3(size_t max) const;
+	Ptr<Packet> add_naked_param(const char *) const;
+	Buffer encode_l3(size_t max, bool binary = false) const;
+	const Buffer& encoded() const;
+	Buffer encoded_binary() const;
+	bool binary() const;
 	Buffer signature() const;
-	Callsign to() const;
-	Callsign from() const;
-	const Params params() const;
-	const Buffer msg() const;
+	const Callsign& to() const;
+	const Callsign& from() const;
+	const Params& params() const;
+	const Buffer& msg() const;
 	int rssi() const;
 
 private:
+	Packet(const Callsign &to, const Callsign &from,
+		const Params& params, const Buffer& msg, int rssi,
+		const Buffer& encoded, size_t preamble_len);
+	friend class PtrInline<Packet>;
+	friend class PtrPooled<Packet>;
+
 	Callsign _to;
 	Callsign _from;
 	const Params _params;
 	Buffer _signature;
 	const Buffer _msg;
 	int _rssi;
+	// wire form cache
+	mutable Buffer _encoded;
+	mutable size_t _preamble_len;
+	// received in binary format
+	bool _binary;
 };
 
 #endif
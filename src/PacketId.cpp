@@ -0,0 +1,52 @@
+/*
+ * LoRaMaDoR (LoRa-based mesh network for hams) project
+ * Copyright (c) 2019 PU5EPX
+ */
+
+/* Allocation of packet IDs.
+ *
+ * Packet IDs must not repeat across restarts, otherwise the network
+ * would discard our new packets as duplicates. Instead of saving every
+ * ID to NVRAM (slow, and wears out the flash), a block of IDs is
+ * reserved by saving its highest ID. IDs are then allocated in RAM
+ * until the block is exhausted.
+ *
+ * Upon boot, the saved ID is taken as the last one used, so the
+ * remainder of a block in use before the restart is skipped.
+ */
+
+#include "PacketId.h"
+#include "NVRAM.h"
+#include "Config.h"
+
+PacketId::PacketId()
+{
+	_last = reserved = arduino_nvram_id_load();
+}
+
+// Gets next packet ID, reserving a new block if necessary
+uint32_t PacketId::next()
+{
+	bool exhausted = (_last == reserved);
+
+	if (++_last > MAX_PACKET_ID) {
+		_last = 1;
+	}
+
+	if (exhausted) {
+		reserved = _last + PACKET_ID_BLOCK - 1;
+		if (reserved > MAX_PACKET_ID) {
+			// block ends at wraparound
+			reserved = MAX_PACKET_ID;
+		}
+		arduino_nvram_id_save(reserved);
+	}
+
+	return _last;
+}
+
+// ID of the latest packet sent by us
+uint32_t PacketId::last() const
+{
+	return _last;
+}
@@ -0,0 +1,32 @@
+/*
+ * LoRaMaDoR (LoRa-based mesh network for hams) project
+ * Copyright (c) 2019 PU5EPX
+ */
+
+// Allocation of packet IDs, persisted to NVRAM in blocks
+
+#ifndef __PACKETID_H
+#define __PACKETID_H
+
+#include <cstdint>
+
+#define MAX_PACKET_ID 9999
+
+class PacketId {
+public:
+	PacketId();
+	uint32_t next();
+	uint32_t last() const;
+
+private:
+	uint32_t _last;
+	// highest ID reserved in NVRAM
+	uint32_t reserved;
+
+	PacketId(const PacketId&) = delete;
+	PacketId(PacketId&&) = delete;
+	PacketId& operator=(const PacketId&) = delete;
+	PacketId& operator=(PacketId&&) = delete;
+};
+
+#endif
@@ -14,13 +14,15 @@
 static const char *naked = " n@ ";
 
 // Parse one parameter key
-static bool parse_symbol_param(const char *data, size_t len, Buffer& key, Buffer& value)
+static bool parse_symbol_param(const BufferView& data, BufferView& key, BufferView& value,
+		bool& is_naked)
 {
+	size_t len = data.length();
 	size_t skey_len = 0;
 	size_t svalue_len = 0;
 
 	// find '=' separator, if exists
-	const char *equal = (const char*) memchr(data, '=', len);
+	const char *equal = data.find('=');
 
 	if (! equal) {
 		// naked key
@@ -28,7 +30,7 @@ static bool parse_symbol_param(const char *data, size_t len, Buffer& key, Buffer
 		svalue_len = 0;
 	} else {
 		// key=value, value may be empty
-		skey_len = equal - data;
+		skey_len = equal - data.data();
 		svalue_len = len - skey_len - 1;
 	}
 
@@ -53,115 +55,111 @@ static bool parse_symbol_param(const char *data, size_t len, Buffer& key, Buffer
 		}
 	}
 
-	key = Buffer(data, skey_len);
-
+	key = data.substr(0, skey_len);
+	is_naked = !equal;
 	if (equal) {
-		value = Buffer(equal + 1, svalue_len);
-	} else {
-		value = Buffer(naked);
+		value = data.substr(skey_len + 1, svalue_len);
 	}
 
 	return true;
 }
 
-// Parse the packet ID
-static bool parse_ident_param(const char* s, size_t len, uint32_t &ident)
+// Parse the packet ID. Must be 1..999999 without leading zeros.
+// Data may not be NUL-terminated, so strtol() is not used.
+static bool parse_ident_param(const BufferView& s, uint32_t &ident)
 {
-	char *stop;
-	ident = strtol(s, &stop, 10);
-	if (ident <= 0) {
-		return false;
-	} else if (ident > 999999) {
-		return false;
-	} else if (len != (unsigned) (stop - s)) {
+	size_t len = s.length();
+	if (len < 1 || len > 6 || s[0] == '0') {
 		return false;
 	}
 
-	char n[10];
-	snprintf(n, 10, "%d", ident);
-	if (strlen(n) != len) {
-		return false;
+	ident = 0;
+	for (size_t i = 0; i < len; ++i) {
+		char c = s[i];
+		if (c < '0' || c > '9') {
+			return false;
+		}
+		ident = ident * 10 + (c - '0');
 	}
 
 	return true;
 }
 
-// Parse a parameter of any kind
-static bool parse_param(const char* data, size_t len,
-		uint32_t &ident, Buffer &key, Buffer &value)
-{
-	char c = data[0];
-
-	if (c >= '0' && c <= '9') {
-		return parse_ident_param(data, len, ident);
-	} else if (c >= 'a' && c <= 'z') {
-		ident = 0;
-		return parse_symbol_param(data, len, key, value);
-	} else if (c >= 'A' && c <= 'Z') {
-		ident = 0;
-		return parse_symbol_param(data, len, key, value);
-	}
-
-	return false;
-}
-
-// Parse parameters of a packet
-static bool parse_params(const char *data, size_t len,
-		uint32_t &ident, Dict<Buffer> &params)
+// Parse parameters of a packet. Validates the data in place; the
+// parameters are copied into 'params' only if it is not null.
+static bool parse_params(const BufferView& data, uint32_t &ident, Dict<Buffer> *params)
 {
 	ident = 0;
-	params = Dict<Buffer>();
+	if (params) {
+		*params = Dict<Buffer>();
+	}
 
-	while (len > 0) {
-		size_t param_len;
-		size_t advance_len;
+	size_t pos = 0;
+	while (pos < data.length()) {
+		BufferView rest = data.substr(pos, data.length() - pos);
+		BufferView param;
 
-		const char *comma = (const char*) memchr(data, ',', len);
+		const char *comma = rest.find(',');
 		if (! comma) {
 			// last, or only, param
-			param_len = len;
-			advance_len = len;
+			param = rest;
 		} else {
-			param_len = comma - data;
-			advance_len = param_len + 1;
+			param = rest.substr(0, comma - rest.data());
 		}
 
-		if (! param_len) {
+		if (param.empty()) {
 			return false;
 		}
+		pos += param.length() + 1;
 
-		uint32_t tident = 0;
-		Buffer key;
-		Buffer value;
+		char c = param[0];
 
-		if (! parse_param(data, param_len, tident, key, value)) {
-			return false;
-		}
-		if (tident) {
-			// parameter is ident
-			ident = tident;
-		} else {
+		if (c >= '0' && c <= '9') {
+			if (! parse_ident_param(param, ident)) {
+				return false;
+			}
+		} else if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
 			// parameter is key=value or naked key
-			key.uppercase();
-			params.put(key, value);
+			BufferView key;
+			BufferView value;
+			bool is_naked;
+			if (! parse_symbol_param(param, key, value, is_naked)) {
+				return false;
+			}
+			if (params) {
+				Buffer ukey = key.str();
+				ukey.uppercase();
+				params->put(ukey, is_naked ? Buffer(naked) : value.str());
+			}
+		} else {
+			return false;
 		}
-
-		data += advance_len;
-		len -= advance_len;
 	}
 
 	return true;
 }
 
+// Validate parameters in place, without copying. Used to check
+// received packets before accepting them.
+bool Params::check(const BufferView& data, uint32_t& ident)
+{
+	return parse_params(data, ident, 0);
+}
+
 Params::Params()
 {
 	_ident = 0;
 	valid = true;
 }
 
-Params::Params(Buffer b)
+Params::Params(const Buffer& b)
+{
+	valid = parse_params(BufferView(b), _ident, &items);
+}
+
+Params::Params(const BufferView& b)
 {
-	valid = parse_params(b.c_str(), b.length(), _ident, items);
+	valid = parse_params(b, _ident, &items);
 }
 
 Vector<Buffer> Params::keys() const
@@ -11,12 +11,15 @@
 #include <cstdint>
 #include "Buffer.h"
 #include "Dict.h"
+#include "BufferView.h"
 
 class Params
 {
 public:
 	Params();
-	Params(Buffer);
+	Params(const Buffer&);
+	Params(const BufferView&);
+	static bool check(const BufferView&, uint32_t& ident);
 	Buffer serialized() const;
 	bool is_valid_with_ident() const;
 	bool is_valid_without_ident() const;
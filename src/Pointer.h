@@ -4,99 +4,181 @@
  */
 
 // Smart pointer implementation.
+//
+// Ptr<T>(new T(...)) allocates a separate control block that holds
+// the reference count. make_ptr<T>(...) allocates the object and the
+// control block together, in a single allocation. A null Ptr does not
+// allocate at all.
 
 #ifndef __PTR_H
 #define __PTR_H
 
 #include <cstddef>
+#include <utility>
 
-template <class T> class PtrRef;
+class Pool;
 
-template <class T> class Ptr
+// Reference count, plus knowledge about how to free the object
+class PtrCtl
+{
+public:
+	PtrCtl(): refcount(1) {}
+	virtual ~PtrCtl() {}
+	// Destroy the object and the control block itself
+	virtual void destroy() = 0;
+
+	size_t refcount;
+};
+
+// Control block of a separately allocated object
+template <class T> class PtrRef: public PtrCtl
 {
 public:
-	inline Ptr()
+	explicit PtrRef(T* p): pointer(p) {}
+	virtual void destroy()
 	{
-		payload = new PtrRef<T>(0);
+		delete pointer;
+		delete this;
 	}
 
-	explicit inline Ptr(T* parg)
+	T* pointer;
+};
+
+// Control block co-allocated with the object
+template <class T> class PtrInline: public PtrCtl
+{
+public:
+	template <class... Args> explicit PtrInline(Args&&... args):
+		obj(std::forward<Args>(args)...) {}
+	virtual void destroy()
 	{
-		payload = new PtrRef<T>(parg);
+		delete this;
 	}
 
-	inline Ptr(const Ptr& arg) 
+	T obj;
+};
+
+template <class T> class Ptr
+{
+public:
+	inline Ptr(): ctl(0), pointer(0)
 	{
-		payload = arg.payload;
-		++payload->refcount;
 	}
 
-	inline Ptr& operator=(const Ptr& outro) 
+	explicit inline Ptr(T* parg): ctl(0), pointer(parg)
 	{
-		++outro.payload->refcount;
-		if(--payload->refcount == 0) {
-			delete payload;
+		if (parg) {
+			ctl = new PtrRef<T>(parg);
 		}
-		payload = outro.payload;
+	}
+
+	inline Ptr(const Ptr& arg): ctl(arg.ctl), pointer(arg.pointer)
+	{
+		acquire();
+	}
+
+	inline Ptr(Ptr&& arg): ctl(arg.ctl), pointer(arg.pointer)
+	{
+		arg.ctl = 0;
+		arg.pointer = 0;
+	}
+
+	// Conversion from Ptr<Derived> to Ptr<Base>
+	template <class U> inline Ptr(const Ptr<U>& arg): ctl(arg.ctl), pointer(arg.pointer)
+	{
+		acquire();
+	}
+
+	template <class U> inline Ptr(Ptr<U>&& arg): ctl(arg.ctl), pointer(arg.pointer)
+	{
+		arg.ctl = 0;
+		arg.pointer = 0;
+	}
+
+	inline Ptr& operator=(const Ptr& outro)
+	{
+		Ptr tmp(outro);
+		swap(tmp);
 		return *this;
 	}
 
-	inline ~Ptr() 
+	inline Ptr& operator=(Ptr&& outro)
 	{
-		if (--payload->refcount == 0) {
-			delete payload;
-			payload = 0;
-		}
+		Ptr tmp(std::move(outro));
+		swap(tmp);
+		return *this;
+	}
+
+	inline ~Ptr()
+	{
+		release();
 	}
 
 	inline T* operator->() const
 	{
-		return payload->pointer;
+		return pointer;
 	}
 
 	inline T& operator*() const
 	{
-		return *(payload->pointer);
+		return *pointer;
 	}
 
 	inline bool operator!() const
 	{
-		return (payload->pointer == 0);
+		return (pointer == 0);
 	}
 
 	inline operator bool() const
 	{
-		return (payload->pointer != 0);
+		return (pointer != 0);
 	}
 
 	inline const T* id() const
 	{
-		return payload->pointer;
+		return pointer;
 	}
 
 private:
-	PtrRef<T>* payload;
-};
+	inline Ptr(PtrCtl* ctl, T* pointer): ctl(ctl), pointer(pointer)
+	{
+	}
 
-template <class T> class PtrRef
-{
-	inline PtrRef(T* p)
+	inline void acquire()
 	{
-		pointer = p;
-		refcount = 1;
+		if (ctl) {
+			++ctl->refcount;
+		}
 	}
 
-	inline ~PtrRef()
+	inline void release()
 	{
-		delete pointer;
+		if (ctl && --ctl->refcount == 0) {
+			ctl->destroy();
+		}
+		ctl = 0;
 		pointer = 0;
 	}
 
+	inline void swap(Ptr& other)
+	{
+		std::swap(ctl, other.ctl);
+		std::swap(pointer, other.pointer);
+	}
+
+	PtrCtl* ctl;
 	T* pointer;
-	size_t refcount;
 
-friend class Ptr<T>;
+template <class U> friend class Ptr;
+template <class U, class... Args> friend Ptr<U> make_ptr(Args&&...);
+template <class U, class... Args> friend Ptr<U> make_pooled_ptr(Pool&, Args&&...);
 };
 
-#endif
+// Allocates object and reference count in a single block
+template <class T, class... Args> Ptr<T> make_ptr(Args&&... args)
+{
+	PtrInline<T>* block = new PtrInline<T>(std::forward<Args>(args)...);
+	return Ptr<T>(block, &block->obj);
+}
 
+#endif
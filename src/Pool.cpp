@@ -0,0 +1,95 @@
+/*
+ * LoRaMaDoR (LoRa-based mesh network for hams) project
+ * Copyright (c) 2019 PU5EPX
+ */
+
+/* Fixed-capacity memory pool for hot, short-lived objects.
+ *
+ * All blocks are allocated at once, when the pool is created, and
+ * free blocks are chained in a list, so allocation and release are O(1)
+ * and never touch the general heap. This avoids heap fragmentation
+ * caused by the packets and tasks created for every received frame.
+ *
+ * When the pool is exhausted, alloc() fails and the failure is counted.
+ * The caller is expected to drop whatever it was going to create.
+ */
+
+#include "Pool.h"
+
+// Blocks are aligned like anything malloc() returns
+static size_t round_block_size(size_t size)
+{
+	const size_t align = alignof(std::max_align_t);
+	if (size < sizeof(void*)) {
+		size = sizeof(void*);
+	}
+	return (size + align - 1) / align * align;
+}
+
+Pool::Pool(const char *name, size_t block_size, size_t capacity):
+	_name(name), block_size(round_block_size(block_size)), _capacity(capacity),
+	free_list(0), _used(0), _peak(0), _dropped(0)
+{
+	storage = new char[this->block_size * capacity];
+	// chain all blocks in free list, first block at the head
+	for (size_t i = capacity; i > 0; --i) {
+		void *block = storage + (i - 1) * this->block_size;
+		*static_cast<void**>(block) = free_list;
+		free_list = block;
+	}
+}
+
+Pool::~Pool()
+{
+	delete [] storage;
+}
+
+// Returns a free block, or 0 if pool is exhausted
+void* Pool::alloc()
+{
+	if (! free_list) {
+		++_dropped;
+		return 0;
+	}
+	void *block = free_list;
+	free_list = *static_cast<void**>(block);
+	if (++_used > _peak) {
+		_peak = _used;
+	}
+	return block;
+}
+
+void Pool::release(void *block)
+{
+	*static_cast<void**>(block) = free_list;
+	free_list = block;
+	--_used;
+}
+
+const char* Pool::name() const
+{
+	return _name;
+}
+
+size_t Pool::capacity() const
+{
+	return _capacity;
+}
+
+// Blocks in use right now
+size_t Pool::used() const
+{
+	return _used;
+}
+
+// Maximum blocks in use at the same time
+size_t Pool::peak() const
+{
+	return _peak;
+}
+
+// Allocations failed due to exhaustion
+size_t Pool::dropped() const
+{
+	return _dropped;
+}
@@ -0,0 +1,76 @@
+/*
+ * LoRaMaDoR (LoRa-based mesh network for hams) project
+ * Copyright (c) 2019 PU5EPX
+ */
+
+// Fixed-capacity memory pool for hot, short-lived objects
+
+#ifndef __POOL_H
+#define __POOL_H
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include "Pointer.h"
+
+class Pool {
+public:
+	Pool(const char *name, size_t block_size, size_t capacity);
+	~Pool();
+
+	void* alloc();
+	void release(void*);
+
+	const char* name() const;
+	size_t capacity() const;
+	size_t used() const;
+	size_t peak() const;
+	size_t dropped() const;
+
+private:
+	const char *_name;
+	size_t block_size;
+	size_t _capacity;
+	char *storage;
+	void *free_list;
+	size_t _used;
+	size_t _peak;
+	size_t _dropped;
+
+	Pool() = delete;
+	Pool(const Pool&) = delete;
+	Pool(Pool&&) = delete;
+	Pool& operator=(const Pool&) = delete;
+	Pool& operator=(Pool&&) = delete;
+};
+
+// Control block co-allocated with the object, in a pool block
+template <class T> class PtrPooled: public PtrCtl
+{
+public:
+	template <class... Args> explicit PtrPooled(Pool* pool, Args&&... args):
+		pool(pool), obj(std::forward<Args>(args)...) {}
+	virtual void destroy()
+	{
+		Pool *p = pool;
+		this->~PtrPooled();
+		p->release(this);
+	}
+
+	Pool *pool;
+	T obj;
+};
+
+// Like make_ptr(), but allocates from a pool. Returns a null Ptr if
+// the pool is exhausted. The pool must outlive the object.
+template <class T, class... Args> Ptr<T> make_pooled_ptr(Pool& pool, Args&&... args)
+{
+	void *mem = pool.alloc();
+	if (! mem) {
+		return Ptr<T>();
+	}
+	PtrPooled<T>* block = new (mem) PtrPooled<T>(&pool, std::forward<Args>(args)...);
+	return Ptr<T>(block, &block->obj);
+}
+
+#endif
@@ -0,0 +1,85 @@
+/*
+ * LoRaMaDoR (LoRa-based mesh network for hams) project
+ * Copyright (c) 2019 PU5EPX
+ */
+
+/* Map of callsign prefixes to values, with longest-prefix match.
+ *
+ * Implemented as a trie in a flat array of nodes. Each node links to
+ * its first child and to its next sibling, so a node costs a few bytes
+ * no matter the alphabet size. Lookup walks one level per character
+ * of the searched string, so it costs O(length) regardless of the
+ * number of prefixes stored.
+ */
+
+#include "PrefixMap.h"
+
+PrefixMap::PrefixMap()
+{
+	clear();
+}
+
+void PrefixMap::clear()
+{
+	nodes = Vector<Node>();
+	values = Vector<Buffer>();
+	nodes.push_back(Node(0));
+}
+
+uint32_t PrefixMap::find_child(uint32_t node, char c) const
+{
+	uint32_t n = nodes[node].child;
+	while (n != NONE && nodes[n].c != c) {
+		n = nodes[n].sibling;
+	}
+	return n;
+}
+
+// Add or replace a prefix. The empty prefix matches everything.
+void PrefixMap::put(const Buffer& prefix, const Buffer& value)
+{
+	uint32_t node = 0;
+	for (size_t i = 0; i < prefix.length(); ++i) {
+		char c = prefix.c_str()[i];
+		uint32_t next = find_child(node, c);
+		if (next == NONE) {
+			next = nodes.count();
+			nodes.push_back(Node(c));
+			nodes[next].sibling = nodes[node].child;
+			nodes[node].child = next;
+		}
+		node = next;
+	}
+
+	if (nodes[node].value == NONE) {
+		nodes[node].value = values.count();
+		values.push_back(value);
+	} else {
+		values[nodes[node].value] = value;
+	}
+}
+
+// Value of the longest prefix of s, or 0 if no prefix matches
+const Buffer* PrefixMap::longest_match(const char *s, size_t len) const
+{
+	uint32_t best = nodes[0].value;
+	uint32_t node = 0;
+
+	for (size_t i = 0; i < len; ++i) {
+		node = find_child(node, s[i]);
+		if (node == NONE) {
+			break;
+		}
+		if (nodes[node].value != NONE) {
+			best = nodes[node].value;
+		}
+	}
+
+	return best == NONE ? 0 : &values[best];
+}
+
+// Number of prefixes stored
+size_t PrefixMap::count() const
+{
+	return values.count();
+}
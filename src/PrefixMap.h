@@ -0,0 +1,43 @@
+/*
+ * LoRaMaDoR (LoRa-based mesh network for hams) project
+ * Copyright (c) 2019 PU5EPX
+ */
+
+// Map of callsign prefixes to values, with longest-prefix match
+
+#ifndef __PREFIXMAP_H
+#define __PREFIXMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include "Vector.h"
+#include "Buffer.h"
+
+class PrefixMap {
+public:
+	PrefixMap();
+	void put(const Buffer& prefix, const Buffer& value);
+	const Buffer* longest_match(const char *s, size_t len) const;
+	size_t count() const;
+	void clear();
+
+private:
+	static const uint32_t NONE = 0xffffffff;
+
+	// Trie node, children are kept as a first-child/next-sibling list
+	struct Node {
+		Node(char c): c(c), child(NONE), sibling(NONE), value(NONE) {}
+		char c;
+		uint32_t child;
+		uint32_t sibling;
+		uint32_t value;
+	};
+
+	uint32_t find_child(uint32_t node, char c) const;
+
+	// node 0 is the root (empty prefix)
+	Vector<Node> nodes;
+	Vector<Buffer> values;
+};
+
+#endif
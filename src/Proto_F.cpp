@@ -0,0 +1,322 @@
+/*
+ * LoRaMaDoR (LoRa-based mesh network for hams) project
+ * Copyright (c) 2019 PU5EPX
+ */
+
+/* Implementation of fragmentation and reassembly (F, FR parameters)
+ *
+ * A packet that would not fit in max_payload() is split in up to
+ * FRAG_MAX_COUNT fragments, each one a packet of its own, tagged with
+ * F=base/index/count. 'base' is the packet ID of the first fragment,
+ * which also carries the original parameters. Fragments are sent in
+ * order.
+ *
+ * The destination reassembles the message keyed by (source, base) and
+ * delivers it to the next protocols as a single packet, with ID 'base'.
+ * Incomplete messages are dropped after FRAG_TIMEOUT. If the last
+ * fragment arrives and others are missing, the destination asks once
+ * for them with FR=base/index/index/... and the source sends them again.
+ */
+
+#include "Proto_F.h"
+#include "Network.h"
+#include "Packet.h"
+#include "Timestamp.h"
+#include "Config.h"
+#include "CLI.h"
+
+static_assert(FRAG_MAX_COUNT <= 32, "FRAG_MAX_COUNT must fit in a 32-bit mask");
+
+static const int64_t FRAG_TIMEOUT = 2 * MINUTES;
+
+Proto_F::Proto_F(Network *net): L4Protocol(net)
+{
+}
+
+// Parse a list of packet IDs/numbers separated by '/'
+static size_t parse_numbers(const Buffer& v, uint32_t *n, size_t max)
+{
+	size_t count = 0;
+	size_t digits = 0;
+	for (size_t i = 0; i <= v.length(); ++i) {
+		int c = (i < v.length()) ? v.charAt(i) : '/';
+		if (c == '/') {
+			if (digits == 0) {
+				return 0;
+			}
+			++count;
+			digits = 0;
+		} else if (c >= '0' && c <= '9' && digits < 6) {
+			if (digits == 0) {
+				if (count >= max) {
+					return 0;
+				}
+				n[count] = 0;
+			}
+			n[count] = n[count] * 10 + (c - '0');
+			++digits;
+		} else {
+			return 0;
+		}
+	}
+	return count;
+}
+
+static Buffer f_value(uint32_t base, size_t index, size_t count)
+{
+	return Buffer::itoa(base) + "/" + Buffer::itoa(index) + "/" + Buffer::itoa(count);
+}
+
+static L4rxHandlerResponse held()
+{
+	L4rxHandlerResponse r;
+	r.hold = true;
+	return r;
+}
+
+// Split the message in chunks that fit in max_payload() once the
+// header is added. A single chunk means no fragmentation is needed.
+Vector<Buffer> Proto_F::split(const Packet& pkt, size_t max_payload)
+{
+	Vector<Buffer> chunks;
+	const Buffer& msg = pkt.msg();
+
+	Params p = pkt.params();
+	p.put("F", f_value(p.ident(), FRAG_MAX_COUNT, FRAG_MAX_COUNT));
+	size_t hdr = Packet(pkt.to(), pkt.from(), p, "").encoded().length() + FRAG_HEADROOM;
+
+	if ((pkt.encoded().length() + FRAG_HEADROOM) <= max_payload || hdr >= max_payload) {
+		chunks.push_back(msg);
+		return chunks;
+	}
+
+	size_t chunk = max_payload - hdr;
+	for (size_t pos = 0; pos < msg.length() && chunks.count() < FRAG_MAX_COUNT; pos += chunk) {
+		chunks.push_back(msg.substr(pos, chunk));
+	}
+	if (msg.length() > chunk * FRAG_MAX_COUNT) {
+		logi("msg too long, truncated to", chunk * FRAG_MAX_COUNT);
+	}
+	return chunks;
+}
+
+L4txHandlerResponse Proto_F::tx(const Packet& pkt)
+{
+	const Params& params = pkt.params();
+	if (params.has("F") || params.has("FR") || params.has("RREQ") || params.has("RRSP")) {
+		return L4txHandlerResponse();
+	}
+
+	Vector<Buffer> chunks = split(pkt, net->max_payload());
+	if (chunks.count() < 2) {
+		return L4txHandlerResponse();
+	}
+
+	uint32_t base = params.ident();
+	size_t count = chunks.count();
+	Params p0 = params;
+	p0.put("F", f_value(base, 0, count));
+	// routing is chosen again when sent
+	p0.remove("V");
+	p0.remove("S");
+
+	if (! pkt.to().is_bcast()) {
+		if (sent.count() >= FRAG_TX_CACHE) {
+			sent.erase(0);
+		}
+		Sent s;
+		s.to = pkt.to();
+		s.base = base;
+		s.params = p0;
+		s.chunks = chunks;
+		s.expiry = sys_timestamp() + FRAG_TIMEOUT;
+		sent.push_back(std::move(s));
+	}
+
+	// This packet is held and the fragments go in order, the first one
+	// under this packet's ID. Otherwise the last fragment could arrive
+	// first and trigger FR for fragments still in flight.
+	net->send_held(pkt.to(), p0, chunks[0]);
+	for (size_t i = 1; i < count; ++i) {
+		Params p;
+		p.put("F", f_value(base, i, count));
+		net->send(pkt.to(), p, chunks[i]);
+	}
+
+	L4txHandlerResponse r;
+	r.hold = true;
+	return r;
+}
+
+L4rxHandlerResponse Proto_F::rx(const Packet& pkt)
+{
+	return rx(pkt, sys_timestamp());
+}
+
+void Proto_F::expire(int64_t now)
+{
+	for (size_t i = partials.count(); i > 0; --i) {
+		if (partials[i-1].expiry <= now) {
+			partials.erase(i-1);
+		}
+	}
+	for (size_t i = sent.count(); i > 0; --i) {
+		if (sent[i-1].expiry <= now) {
+			sent.erase(i-1);
+		}
+	}
+}
+
+// Find or create reassembly entry. When full, the oldest is dropped.
+Proto_F::Partial& Proto_F::partial(const Callsign& from, uint32_t base, uint32_t count,
+				int64_t now)
+{
+	for (size_t i = 0; i < partials.count(); ++i) {
+		if (partials[i].base == base && partials[i].from == from) {
+			return partials[i];
+		}
+	}
+
+	if (partials.count() >= FRAG_REASSEMBLY_SLOTS) {
+		size_t oldest = 0;
+		for (size_t i = 1; i < partials.count(); ++i) {
+			if (partials[i].expiry < partials[oldest].expiry) {
+				oldest = i;
+			}
+		}
+		logs("fragments dropped, reassembly full", partials[oldest].from);
+		partials.erase(oldest);
+	}
+
+	Partial& p = partials.emplace_back();
+	p.from = from;
+	p.base = base;
+	p.count = count;
+	p.received = 0;
+	for (size_t i = 0; i < count; ++i) {
+		p.chunks.push_back(Buffer());
+	}
+	p.done = false;
+	p.nacked = false;
+	p.expiry = now + FRAG_TIMEOUT;
+	return p;
+}
+
+L4rxHandlerResponse Proto_F::rx(const Packet& pkt, int64_t now)
+{
+	expire(now);
+
+	if (pkt.params().has("FR")) {
+		return retransmit(pkt, now);
+	}
+	if (! pkt.params().has("F")) {
+		return L4rxHandlerResponse();
+	}
+
+	uint32_t n[3];
+	if (parse_numbers(pkt.params().get("F"), n, 3) != 3 || n[0] < 1
+			|| n[2] < 2 || n[2] > FRAG_MAX_COUNT || n[1] >= n[2]) {
+		return L4rxHandlerResponse(false, Callsign(), Params(), "", true, "bad F param");
+	}
+	uint32_t base = n[0];
+	uint32_t index = n[1];
+	uint32_t count = n[2];
+
+	Partial& p = partial(pkt.from(), base, count, now);
+	if (p.done) {
+		// late copy of a delivered message
+		return held();
+	}
+	if (p.count != count) {
+		return L4rxHandlerResponse(false, Callsign(), Params(), "", true,
+				"fragment count mismatch");
+	}
+
+	uint32_t all = (count == 32) ? 0xffffffffu : ((1u << count) - 1);
+	if (! (p.received & (1u << index))) {
+		p.received |= 1u << index;
+		p.chunks[index] = pkt.msg();
+		if (index == 0) {
+			p.params = pkt.params();
+			p.params.remove("F");
+			p.params.set_ident(base);
+		}
+		p.expiry = now + FRAG_TIMEOUT;
+	}
+
+	if (p.received == all) {
+		Buffer msg;
+		for (size_t i = 0; i < count; ++i) {
+			msg += p.chunks[i];
+		}
+		Ptr<Packet> whole = make_ptr<Packet>(pkt.to(), pkt.from(), p.params, msg,
+					pkt.rssi());
+		// keep entry to ignore late copies
+		p.done = true;
+		p.chunks = Vector<Buffer>();
+		return L4rxHandlerResponse(whole);
+	}
+
+	if (index == (count - 1) && ! p.nacked && ! pkt.to().is_bcast()) {
+		// ask for missing fragments, once
+		p.nacked = true;
+		Buffer missing = Buffer::itoa(base);
+		for (size_t i = 0; i < count; ++i) {
+			if (! (p.received & (1u << i))) {
+				missing += '/';
+				missing += Buffer::itoa(i);
+			}
+		}
+		Params fr;
+		fr.put("FR", missing);
+		L4rxHandlerResponse r(true, pkt.from(), fr, "", false, "");
+		r.hold = true;
+		return r;
+	}
+
+	return held();
+}
+
+// Send again the fragments asked by the destination
+L4rxHandlerResponse Proto_F::retransmit(const Packet& pkt, int64_t now)
+{
+	uint32_t n[FRAG_MAX_COUNT + 1];
+	size_t count = parse_numbers(pkt.params().get("FR"), n, FRAG_MAX_COUNT + 1);
+	if (count < 2) {
+		return L4rxHandlerResponse(false, Callsign(), Params(), "", true, "bad FR param");
+	}
+
+	for (size_t i = 0; i < sent.count(); ++i) {
+		const Sent& s = sent[i];
+		if (s.base != n[0] || ! (s.to == pkt.from())) {
+			continue;
+		}
+		for (size_t j = 1; j < count; ++j) {
+			size_t index = n[j];
+			if (index >= s.chunks.count()) {
+				continue;
+			}
+			Params p = s.params;
+			if (index > 0) {
+				p = Params();
+				p.put("F", f_value(s.base, index, s.chunks.count()));
+			}
+			net->send(s.to, p, s.chunks[index]);
+		}
+		break;
+	}
+
+	return held();
+}
+
+// Messages under reassembly
+size_t Proto_F::pending() const
+{
+	size_t n = 0;
+	for (size_t i = 0; i < partials.count(); ++i) {
+		if (! partials[i].done) {
+			++n;
+		}
+	}
+	return n;
+}
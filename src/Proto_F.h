@@ -0,0 +1,63 @@
+/*
+ * LoRaMaDoR (LoRa-based mesh network for hams) project
+ * Copyright (c) 2019 PU5EPX
+ */
+
+// Implementation of fragmentation and reassembly (F, FR parameters)
+
+#ifndef __PROTO_F_H
+#define __PROTO_F_H
+
+#include "L4Protocol.h"
+#include "Vector.h"
+#include "Buffer.h"
+
+class Proto_F: public L4Protocol {
+public:
+	Proto_F(Network* net);
+	virtual L4txHandlerResponse tx(const Packet&);
+	virtual L4rxHandlerResponse rx(const Packet&);
+
+	// publicised for testing
+	L4rxHandlerResponse rx(const Packet&, int64_t now);
+	static Vector<Buffer> split(const Packet&, size_t max_payload);
+	size_t pending() const;
+
+	Proto_F() = delete;
+	Proto_F(const Proto_F&) = delete;
+	Proto_F(Proto_F&&) = delete;
+	Proto_F& operator=(const Proto_F&) = delete;
+	Proto_F& operator=(Proto_F&&) = delete;
+
+private:
+	// Message being reassembled
+	struct Partial {
+		Callsign from;
+		uint32_t base;
+		uint32_t count;
+		uint32_t received;
+		Vector<Buffer> chunks;
+		Params params;
+		bool done;
+		bool nacked;
+		int64_t expiry;
+	};
+
+	// Message sent, kept for selective retransmission
+	struct Sent {
+		Callsign to;
+		uint32_t base;
+		Params params;
+		Vector<Buffer> chunks;
+		int64_t expiry;
+	};
+
+	void expire(int64_t now);
+	Partial& partial(const Callsign& from, uint32_t base, uint32_t count, int64_t now);
+	L4rxHandlerResponse retransmit(const Packet&, int64_t now);
+
+	Vector<Partial> partials;
+	Vector<Sent> sent;
+};
+
+#endif
@@ -17,48 +17,101 @@ Proto_HMAC::Proto_HMAC(Network *net): L4Protocol(net)
 
 L4rxHandlerResponse Proto_HMAC::rx(const Packet& orig_pkt)
 {
-	Buffer key = HMACKeys::get_key_for(orig_pkt.from());
-	if (key.empty()) {
-		return L4rxHandlerResponse();
-	}
-	return Proto_HMAC_rx(key, orig_pkt);
+	return Proto_HMAC_verify(net, orig_pkt);
 }
 
-L4rxHandlerResponse Proto_HMAC_rx(const Buffer& key, const Packet& orig_pkt)
+// HMAC of a packet, covers destination, source, ID and message
+static Buffer packet_hmac(const Buffer& key, const Packet& pkt)
+{
+	HMACHasher hasher(key);
+	hasher.write(pkt.to().c_str(), pkt.to().length());
+	hasher.write(pkt.from().c_str(), pkt.from().length());
+	hasher.write(pkt.params().s_ident());
+	hasher.write(pkt.msg());
+	return hasher.result();
+}
+
+// Verification outcomes, as memoized in recv log (0 = not verified yet)
+enum {
+	HMAC_OK = 1,
+	HMAC_MISSING,
+	HMAC_BAD_SIZE,
+	HMAC_BAD,
+};
+
+static uint8_t verify(const Buffer& key, const Packet& orig_pkt)
 {
-	auto p = orig_pkt.params();
+	const Params& p = orig_pkt.params();
 
 	if (p.has("RREQ") || p.has("RRSP")) {
-		return L4rxHandlerResponse();
+		return HMAC_OK;
 	}
 
 	if (! p.has("H")) {
-		return L4rxHandlerResponse(false, Callsign(), Params(), "",
-			true, "Packet w/o HMAC");
+		return HMAC_MISSING;
 	}
 
 	Buffer recv_hmac = p.get("H");
 	if (recv_hmac.length() != 12) {
-		return L4rxHandlerResponse(false, Callsign(), Params(), "",
-			true, "Invalid HMAC size");
+		return HMAC_BAD_SIZE;
 	}
 
 	// recalculate HMAC locally and compare
-	auto data = Buffer(orig_pkt.to()) + orig_pkt.from() +
-		orig_pkt.params().s_ident() + orig_pkt.msg();
-	auto hmac = HMACKeys::hmac(key, data);
+	auto hmac = packet_hmac(key, orig_pkt);
 
 	if (hmac != recv_hmac) {
+		return HMAC_BAD;
+	}
+
+	return HMAC_OK;
+}
+
+static L4rxHandlerResponse verify_response(uint8_t verdict)
+{
+	switch (verdict) {
+	case HMAC_MISSING:
+		return L4rxHandlerResponse(false, Callsign(), Params(), "",
+			true, "Packet w/o HMAC");
+	case HMAC_BAD_SIZE:
+		return L4rxHandlerResponse(false, Callsign(), Params(), "",
+			true, "Invalid HMAC size");
+	case HMAC_BAD:
 		return L4rxHandlerResponse(false, Callsign(), Params(), "",
 			true, "Bad HMAC");
 	}
-
 	return L4rxHandlerResponse();
 }
 
+L4rxHandlerResponse Proto_HMAC_rx(const Buffer& key, const Packet& orig_pkt)
+{
+	return verify_response(verify(key, orig_pkt));
+}
+
+// Verify HMAC of a received packet. The outcome is memoized in the
+// recv log entry of the packet, so a packet that is both relayed and
+// delivered locally is verified only once.
+L4rxHandlerResponse Proto_HMAC_verify(Network* net, const Packet& orig_pkt)
+{
+	const Buffer& key = HMACKeys::get_key_for(orig_pkt.from());
+	if (key.empty()) {
+		return L4rxHandlerResponse();
+	}
+
+	RecvLogItem* item = net->recv_log_item(orig_pkt);
+	if (item && item->hmac) {
+		return verify_response(item->hmac);
+	}
+
+	uint8_t verdict = verify(key, orig_pkt);
+	if (item) {
+		item->hmac = verdict;
+	}
+	return verify_response(verdict);
+}
+
 L4txHandlerResponse Proto_HMAC::tx(const Packet& orig_pkt)
 {
-	Buffer key = HMACKeys::get_key_for(orig_pkt.from());
+	const Buffer& key = HMACKeys::get_key_for(orig_pkt.from());
 	if (key.empty()) {
 		return L4txHandlerResponse();
 	}
@@ -67,15 +120,11 @@ L4txHandlerResponse Proto_HMAC::tx(const Packet& orig_pkt)
 
 L4txHandlerResponse Proto_HMAC_tx(const Buffer& key, const Packet& orig_pkt)
 {
-	auto p = orig_pkt.params();
-	if (p.has("RREQ") || p.has("RRSP")) {
+	if (orig_pkt.params().has("RREQ") || orig_pkt.params().has("RRSP")) {
 		return L4txHandlerResponse();
 	}
 
-	auto data = Buffer(orig_pkt.to()) + orig_pkt.from() +
-		orig_pkt.params().s_ident() + orig_pkt.msg();
-	auto hmac = HMACKeys::hmac(key, data);
-
-	p.put("H", hmac);
+	Params p = orig_pkt.params();
+	p.put("H", packet_hmac(key, orig_pkt));
 	return L4txHandlerResponse(orig_pkt.change_params(p));
 }
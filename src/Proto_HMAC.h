@@ -26,6 +26,7 @@ public:
 
 L4txHandlerResponse Proto_HMAC_tx(const Buffer&, const Packet&);
 L4rxHandlerResponse Proto_HMAC_rx(const Buffer&, const Packet&);
+L4rxHandlerResponse Proto_HMAC_verify(Network*, const Packet&);
 Buffer Proto_HMAC_hmac(const Buffer& key, const Buffer& data);
 
 #endif
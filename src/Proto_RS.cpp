@@ -0,0 +1,569 @@
+/*
+ * LoRaMaDoR (LoRa-based mesh network for hams) project
+ * Copyright (c) 2019 PU5EPX
+ */
+
+/* Implementation of reliable transport (RS, RA, RAO parameters)
+ *
+ * Messages sent with the naked RS param to an unicast destination
+ * become segments of a stream, tagged RS=stream/seq. Up to RS_WINDOW
+ * segments may be in flight, further messages wait for the window.
+ *
+ * The destination delivers each segment once, as it arrives (the app
+ * may use RS to order them) and acknowledges with RA=stream/cum/mask:
+ * all segments up to 'cum' were received, plus those flagged in the
+ * hex bitmask (bit 0 = cum + 1). RA rides on any packet going back to
+ * the source; if there is none within RS_ACK_DELAY, a packet with RA
+ * and RAO (ack only, not delivered) is sent.
+ *
+ * A message that waited for the window is sent under the packet ID that
+ * the app was given. Segments not acknowledged within the retransmission
+ * timeout are sent again, as new packets. The timeout follows the RTT (Jacobson/Karels),
+ * sampled from acks of segments sent once, and from CO confirmations
+ * of packets sent with C. Timeouts double the RTO, up to RS_RTO_MAX.
+ * A timeout, or a CO missing after the RTO, tells the network that the
+ * route to the destination failed, so retransmissions go by diffusion.
+ *
+ * Segments in flight never span more than the 32 tracked by the bitmask.
+ * A segment is given up after RS_MAX_RETRIES; when a segment arrives
+ * beyond the window, the destination moves the window on, skipping
+ * what was given up (or forgotten, if the destination lost its state).
+ */
+
+#include <stdio.h>
+#include "Proto_RS.h"
+#include "Network.h"
+#include "Packet.h"
+#include "Timestamp.h"
+#include "Config.h"
+#include "CLI.h"
+
+static_assert(RS_WINDOW <= 32, "RS_WINDOW must fit in the RA bitmask");
+
+static const int64_t RS_RTO_INITIAL = 30 * SECONDS;
+static const int64_t RS_RTO_MIN = 5 * SECONDS;
+static const int64_t RS_RTO_MAX = 5 * MINUTES;
+static const int64_t RS_ACK_DELAY = 2 * SECONDS;
+static const size_t RS_PROBES = 4;
+// segments tracked by the receiver past 'cum' (RA bitmask)
+static const uint32_t RS_SPAN = 32;
+
+// Task that runs retransmission and ack timers
+class RSTask: public Task
+{
+public:
+	RSTask(Proto_RS *rs, int64_t offset):
+		Task("rs", offset), rs(rs)
+	{
+	}
+	~RSTask() {
+		rs = 0;
+	}
+protected:
+	virtual int64_t run2(int64_t now)
+	{
+		return rs->tick(now);
+	}
+private:
+	Proto_RS *rs;
+};
+
+Proto_RS::Proto_RS(Network *net): L4Protocol(net)
+{
+	// no timers when unit-tested without a network
+	if (net) {
+		task = make_ptr<RSTask>(this, MAX_IDLE_TIME);
+		net->schedule(task);
+	}
+}
+
+void Proto_RS::transmit(const Callsign& to, const Params& params, const Buffer& msg,
+			bool held)
+{
+	if (held) {
+		net->send_held(to, params, msg);
+	} else {
+		net->send(to, params, msg);
+	}
+}
+
+void Proto_RS::route_failed(const Callsign& to)
+{
+	net->route_failed(to);
+}
+
+// Make sure the timer task runs by 'due'
+void Proto_RS::wake(int64_t due, int64_t now)
+{
+	if (! task || task->next_run() <= due) {
+		return;
+	}
+	net->cancel(task.id());
+	task = make_ptr<RSTask>(this, due > now ? due - now : 0);
+	net->schedule(task);
+}
+
+Proto_RS::Stream* Proto_RS::find_stream(const Callsign& to)
+{
+	for (size_t i = 0; i < streams.count(); ++i) {
+		if (streams[i].to == to) {
+			return &streams[i];
+		}
+	}
+	return 0;
+}
+
+const Proto_RS::Stream* Proto_RS::find_stream(const Callsign& to) const
+{
+	return const_cast<Proto_RS*>(this)->find_stream(to);
+}
+
+// Find or create sender state. When full, the least recently used
+// stream is forgotten, preferably an idle one.
+Proto_RS::Stream& Proto_RS::stream(const Callsign& to, int64_t now)
+{
+	Stream* s = find_stream(to);
+	if (s) {
+		s->last_use = now;
+		return *s;
+	}
+
+	if (streams.count() >= RS_STREAMS) {
+		size_t victim = 0;
+		for (size_t i = 1; i < streams.count(); ++i) {
+			bool idle = streams[i].flight.count() == 0 && streams[i].waiting.count() == 0;
+			bool vidle = streams[victim].flight.count() == 0
+					&& streams[victim].waiting.count() == 0;
+			if ((idle && ! vidle) || (idle == vidle
+					&& streams[i].last_use < streams[victim].last_use)) {
+				victim = i;
+			}
+		}
+		if (streams[victim].flight.count() > 0) {
+			logs("reliable stream dropped", streams[victim].to);
+		}
+		streams.erase(victim);
+	}
+
+	Stream& n = streams.emplace_back();
+	n.to = to;
+	n.id = 0;
+	n.next_seq = 1;
+	n.srtt = 0;
+	n.rttvar = 0;
+	n.rto = RS_RTO_INITIAL;
+	n.last_use = now;
+	return n;
+}
+
+Proto_RS::Receiver* Proto_RS::find_receiver(const Callsign& from)
+{
+	for (size_t i = 0; i < receivers.count(); ++i) {
+		if (receivers[i].from == from) {
+			return &receivers[i];
+		}
+	}
+	return 0;
+}
+
+Buffer Proto_RS::ack_value(const Receiver& r)
+{
+	char mask[9];
+	snprintf(mask, sizeof(mask), "%x", (unsigned int) r.mask);
+	return Buffer::itoa(r.id) + "/" + Buffer::itoa(r.cum) + "/" + mask;
+}
+
+void Proto_RS::rtt_sample(Stream& s, int64_t rtt)
+{
+	if (s.srtt == 0) {
+		s.srtt = rtt;
+		s.rttvar = rtt / 2;
+	} else {
+		int64_t err = s.srtt > rtt ? s.srtt - rtt : rtt - s.srtt;
+		s.rttvar = (3 * s.rttvar + err) / 4;
+		s.srtt = (7 * s.srtt + rtt) / 8;
+	}
+	s.rto = s.srtt + 4 * s.rttvar;
+	if (s.rto < RS_RTO_MIN) {
+		s.rto = RS_RTO_MIN;
+	} else if (s.rto > RS_RTO_MAX) {
+		s.rto = RS_RTO_MAX;
+	}
+}
+
+// Assign the next sequence number to a segment
+void Proto_RS::number(Stream& s, Segment& seg, int64_t now)
+{
+	if (s.id == 0) {
+		s.id = seg.params.ident();
+	}
+	seg.seq = s.next_seq++;
+	seg.params.put("RS", Buffer::itoa(s.id) + "/" + Buffer::itoa(seg.seq));
+	seg.sent_at = now;
+}
+
+// Whether another segment may be sent. Besides the window limit, the
+// segments in flight must fit in the receiver's bitmask.
+bool Proto_RS::window_open(const Stream& s)
+{
+	if (s.flight.count() >= RS_WINDOW) {
+		return false;
+	}
+	for (size_t i = 0; i < s.flight.count(); ++i) {
+		if ((s.next_seq - s.flight[i].seq) >= RS_SPAN) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Send messages waiting for the window
+void Proto_RS::release(Stream& s, int64_t now)
+{
+	Callsign to = s.to;
+	while (window_open(s) && s.waiting.count() > 0) {
+		Segment seg = std::move(s.waiting[0]);
+		s.waiting.erase(0);
+		number(s, seg, now);
+		Params params = seg.params;
+		Buffer msg = seg.msg;
+		s.flight.push_back(std::move(seg));
+		wake(now + s.rto, now);
+		transmit(to, params, msg, true);
+	}
+}
+
+L4txHandlerResponse Proto_RS::tx(const Packet& pkt)
+{
+	return tx(pkt, sys_timestamp());
+}
+
+L4txHandlerResponse Proto_RS::tx(const Packet& pkt, int64_t now)
+{
+	const Callsign& to = pkt.to();
+	Params p = pkt.params();
+	bool changed = false;
+
+	if (to.is_bcast()) {
+		if (p.has("RS") && p.is_key_naked("RS")) {
+			p.remove("RS");
+			return L4txHandlerResponse(pkt.change_params(p));
+		}
+		return L4txHandlerResponse();
+	}
+
+	if (p.has("RS") && p.is_key_naked("RS")) {
+		Stream& s = stream(to, now);
+		Segment seg;
+		seg.params = p;
+		// routing is chosen again when sent
+		seg.params.remove("V");
+		seg.params.remove("S");
+		seg.msg = pkt.msg();
+		seg.retries = 0;
+		seg.sent_at = now;
+
+		if (! window_open(s) || s.waiting.count() > 0) {
+			if (s.waiting.count() >= RS_BACKLOG) {
+				logs("reliable msg dropped, backlog full", to);
+			} else {
+				seg.seq = 0;
+				s.waiting.push_back(std::move(seg));
+			}
+			L4txHandlerResponse held;
+			held.hold = true;
+			return held;
+		}
+
+		number(s, seg, now);
+		p.put("RS", seg.params.get("RS"));
+		s.flight.push_back(std::move(seg));
+		wake(now + s.rto, now);
+		changed = true;
+	}
+
+	if (p.has("C") && ! p.has("CO") && ! p.has("F")) {
+		// RTT probe, taken when the packet is actually sent
+		// (fragments go after the whole packet was seen)
+		if (probes.count() >= RS_PROBES) {
+			probes.erase(0);
+		}
+		Probe& probe = probes.emplace_back();
+		probe.to = to;
+		probe.ident = p.ident();
+		probe.sent_at = now;
+		wake(now + rto(to), now);
+	}
+
+	// piggyback ack, except on fragments that are not the first,
+	// since they are held until reassembly
+	Receiver* r = find_receiver(to);
+	if (r && r->ack_owed && ! p.has("RA") && ! p.has("F")) {
+		p.put("RA", ack_value(*r));
+		r->ack_owed = false;
+		changed = true;
+	}
+
+	if (changed) {
+		return L4txHandlerResponse(pkt.change_params(p));
+	}
+	return L4txHandlerResponse();
+}
+
+// Process acknowledgement from a destination
+void Proto_RS::acked(const Callsign& from, const Buffer& ra, int64_t now)
+{
+	unsigned int id, cum, mask;
+	int consumed = 0;
+	if (sscanf(ra.c_str(), "%u/%u/%x%n", &id, &cum, &mask, &consumed) != 3
+			|| (size_t) consumed != ra.length()) {
+		logs("bad RA param", ra);
+		return;
+	}
+
+	Stream* s = find_stream(from);
+	if (! s || s->id != id) {
+		return;
+	}
+	s->last_use = now;
+
+	for (size_t i = s->flight.count(); i > 0; --i) {
+		const Segment& seg = s->flight[i-1];
+		bool ok = seg.seq <= cum;
+		if (! ok && (seg.seq - cum - 1) < 32) {
+			ok = mask & (1u << (seg.seq - cum - 1));
+		}
+		if (ok) {
+			if (seg.retries == 0) {
+				// Karn: retransmitted segments give ambiguous samples
+				rtt_sample(*s, now - seg.sent_at);
+			}
+			s->flight.erase(i-1);
+		}
+	}
+
+	release(*s, now);
+}
+
+// Process data segment. Returns false if it is a duplicate.
+bool Proto_RS::segment(const Callsign& from, const Buffer& rs, int64_t now)
+{
+	unsigned int id, seq;
+	int consumed = 0;
+	if (sscanf(rs.c_str(), "%u/%u%n", &id, &seq, &consumed) != 2
+			|| (size_t) consumed != rs.length() || id == 0 || seq == 0) {
+		// not a segment, deliver as is
+		return true;
+	}
+
+	Receiver* r = find_receiver(from);
+	if (! r) {
+		if (receivers.count() >= RS_STREAMS) {
+			size_t oldest = 0;
+			for (size_t i = 1; i < receivers.count(); ++i) {
+				if (receivers[i].last_use < receivers[oldest].last_use) {
+					oldest = i;
+				}
+			}
+			receivers.erase(oldest);
+		}
+		r = &receivers.emplace_back();
+		r->from = from;
+		r->id = 0;
+		r->cum = 0;
+		r->mask = 0;
+		r->ack_owed = false;
+		r->ack_due = 0;
+	}
+	if (r->id != id) {
+		// new stream, e.g. source restarted
+		r->id = id;
+		r->cum = 0;
+		r->mask = 0;
+		r->ack_owed = false;
+	}
+	r->last_use = now;
+
+	if (! r->ack_owed) {
+		r->ack_owed = true;
+		r->ack_due = now + RS_ACK_DELAY;
+		wake(r->ack_due, now);
+	}
+
+	if (seq <= r->cum) {
+		return false;
+	}
+	uint32_t bit = seq - r->cum - 1;
+	if (bit >= RS_SPAN) {
+		// the source gave up earlier segments, or this receiver was
+		// forgotten and recreated: move the window on
+		uint32_t shift = bit - (RS_SPAN - 1);
+		r->mask = shift < 32 ? r->mask >> shift : 0;
+		r->cum += shift;
+		bit = RS_SPAN - 1;
+	}
+	if (r->mask & (1u << bit)) {
+		return false;
+	}
+
+	r->mask |= 1u << bit;
+	while (r->mask & 1) {
+		r->mask >>= 1;
+		++r->cum;
+	}
+	return true;
+}
+
+L4rxHandlerResponse Proto_RS::rx(const Packet& pkt)
+{
+	return rx(pkt, sys_timestamp());
+}
+
+L4rxHandlerResponse Proto_RS::rx(const Packet& pkt, int64_t now)
+{
+	const Params& p = pkt.params();
+	L4rxHandlerResponse held;
+	held.hold = true;
+
+	if (p.has("RA")) {
+		acked(pkt.from(), p.get("RA"), now);
+	}
+
+	if (p.has("CO")) {
+		// confirmation of a C packet, sample RTT
+		const Buffer& msg = pkt.msg();
+		uint32_t ident = msg.startsWith("confirm ") ? msg.substr(8).toInt() : 0;
+		for (size_t i = 0; ident && i < probes.count(); ++i) {
+			if (probes[i].ident == ident && probes[i].to == pkt.from()) {
+				// only useful to a stream that exists already
+				Stream* s = find_stream(pkt.from());
+				if (s) {
+					rtt_sample(*s, now - probes[i].sent_at);
+				}
+				probes.erase(i);
+				break;
+			}
+		}
+	}
+
+	if (p.has("RAO")) {
+		return held;
+	}
+
+	if (p.has("RS") && ! pkt.to().is_bcast()) {
+		if (! segment(pkt.from(), p.get("RS"), now)) {
+			return held;
+		}
+	}
+
+	return L4rxHandlerResponse();
+}
+
+// Retransmission and delayed ack timers. Returns when to run again.
+int64_t Proto_RS::tick(int64_t now)
+{
+	for (size_t i = 0; i < streams.count(); ++i) {
+		Stream& s = streams[i];
+		Callsign to = s.to;
+		bool timed_out = false;
+
+		for (size_t j = s.flight.count(); j > 0; --j) {
+			Segment& seg = s.flight[j-1];
+			if ((seg.sent_at + s.rto) > now) {
+				continue;
+			}
+			if (seg.retries >= RS_MAX_RETRIES) {
+				logs("reliable msg given up", to);
+				s.flight.erase(j-1);
+				continue;
+			}
+			if (! timed_out) {
+				route_failed(to);
+			}
+			++seg.retries;
+			seg.sent_at = now;
+			timed_out = true;
+			Params params = seg.params;
+			Buffer msg = seg.msg;
+			transmit(to, params, msg, false);
+		}
+
+		if (timed_out) {
+			s.rto *= 2;
+			if (s.rto > RS_RTO_MAX) {
+				s.rto = RS_RTO_MAX;
+			}
+		}
+		release(s, now);
+	}
+
+	for (size_t i = probes.count(); i > 0; --i) {
+		if ((probes[i-1].sent_at + rto(probes[i-1].to)) <= now) {
+			// CO did not come back
+			Callsign to = probes[i-1].to;
+			probes.erase(i-1);
+			route_failed(to);
+		}
+	}
+
+	for (size_t i = 0; i < receivers.count(); ++i) {
+		Receiver& r = receivers[i];
+		if (r.ack_owed && r.ack_due <= now) {
+			r.ack_owed = false;
+			Params params;
+			params.put("RA", ack_value(r));
+			params.put_naked("RAO");
+			Callsign from = r.from;
+			transmit(from, params, "", false);
+		}
+	}
+
+	return next_deadline(now);
+}
+
+// Time until the next retransmission, ack or probe timeout is due
+int64_t Proto_RS::next_deadline(int64_t now) const
+{
+	int64_t next = now + MAX_IDLE_TIME;
+	for (size_t i = 0; i < streams.count(); ++i) {
+		const Stream& s = streams[i];
+		for (size_t j = 0; j < s.flight.count(); ++j) {
+			if ((s.flight[j].sent_at + s.rto) < next) {
+				next = s.flight[j].sent_at + s.rto;
+			}
+		}
+	}
+	for (size_t i = 0; i < probes.count(); ++i) {
+		if ((probes[i].sent_at + rto(probes[i].to)) < next) {
+			next = probes[i].sent_at + rto(probes[i].to);
+		}
+	}
+	for (size_t i = 0; i < receivers.count(); ++i) {
+		if (receivers[i].ack_owed && receivers[i].ack_due < next) {
+			next = receivers[i].ack_due;
+		}
+	}
+	// a task returning 0 would be finished
+	return next > now ? next - now : 1;
+}
+
+// Retransmission timeout towards a destination
+int64_t Proto_RS::rto(const Callsign& to) const
+{
+	const Stream* s = find_stream(to);
+	return s ? s->rto : RS_RTO_INITIAL;
+}
+
+// Segments sent but not acknowledged yet
+size_t Proto_RS::in_flight(const Callsign& to) const
+{
+	const Stream* s = find_stream(to);
+	return s ? s->flight.count() : 0;
+}
+
+// Messages waiting for the window
+size_t Proto_RS::backlog(const Callsign& to) const
+{
+	const Stream* s = find_stream(to);
+	return s ? s->waiting.count() : 0;
+}
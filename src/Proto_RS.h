@@ -0,0 +1,105 @@
+/*
+ * LoRaMaDoR (LoRa-based mesh network for hams) project
+ * Copyright (c) 2019 PU5EPX
+ */
+
+// Implementation of reliable transport (RS, RA, RAO parameters)
+
+#ifndef __PROTO_RS_H
+#define __PROTO_RS_H
+
+#include "L4Protocol.h"
+#include "Vector.h"
+#include "Buffer.h"
+#include "Task.h"
+
+class Proto_RS: public L4Protocol {
+public:
+	Proto_RS(Network* net);
+	virtual L4txHandlerResponse tx(const Packet&);
+	virtual L4rxHandlerResponse rx(const Packet&);
+	int64_t tick(int64_t now);
+	int64_t next_deadline(int64_t now) const;
+
+	// publicised for testing
+	L4txHandlerResponse tx(const Packet&, int64_t now);
+	L4rxHandlerResponse rx(const Packet&, int64_t now);
+	int64_t rto(const Callsign& to) const;
+	size_t in_flight(const Callsign& to) const;
+	size_t backlog(const Callsign& to) const;
+
+	Proto_RS() = delete;
+	Proto_RS(const Proto_RS&) = delete;
+	Proto_RS(Proto_RS&&) = delete;
+	Proto_RS& operator=(const Proto_RS&) = delete;
+	Proto_RS& operator=(Proto_RS&&) = delete;
+
+protected:
+	// sends a packet through the network; overridden in tests.
+	// 'held' = first transmission, under the ID already given to the app
+	virtual void transmit(const Callsign& to, const Params&, const Buffer& msg, bool held);
+	// reports a timeout, so the network falls back to diffusion
+	virtual void route_failed(const Callsign& to);
+
+private:
+	struct Segment {
+		uint32_t seq;
+		Params params;
+		Buffer msg;
+		int64_t sent_at;
+		uint32_t retries;
+	};
+
+	// Sender side, one per destination
+	struct Stream {
+		Callsign to;
+		uint32_t id;
+		uint32_t next_seq;
+		Vector<Segment> flight;
+		Vector<Segment> waiting;
+		// RTT estimation
+		int64_t srtt;
+		int64_t rttvar;
+		int64_t rto;
+		int64_t last_use;
+	};
+
+	// Receiver side, one per source
+	struct Receiver {
+		Callsign from;
+		uint32_t id;
+		// all segments up to cum were received, plus those in mask
+		uint32_t cum;
+		uint32_t mask;
+		bool ack_owed;
+		int64_t ack_due;
+		int64_t last_use;
+	};
+
+	// C packet waiting for CO, used to measure RTT
+	struct Probe {
+		Callsign to;
+		uint32_t ident;
+		int64_t sent_at;
+	};
+
+	Stream* find_stream(const Callsign& to);
+	const Stream* find_stream(const Callsign& to) const;
+	Stream& stream(const Callsign& to, int64_t now);
+	Receiver* find_receiver(const Callsign& from);
+	void rtt_sample(Stream&, int64_t rtt);
+	void acked(const Callsign& from, const Buffer& ra, int64_t now);
+	bool segment(const Callsign& from, const Buffer& rs, int64_t now);
+	void number(Stream&, Segment&, int64_t now);
+	void release(Stream&, int64_t now);
+	static bool window_open(const Stream&);
+	void wake(int64_t due, int64_t now);
+	static Buffer ack_value(const Receiver&);
+
+	Ptr<Task> task;
+	Vector<Stream> streams;
+	Vector<Receiver> receivers;
+	Vector<Probe> probes;
+};
+
+#endif
@@ -103,7 +103,7 @@ private:
 
 Proto_Switch::Proto_Switch(Network *net): L7Protocol(net)
 {
-	net->schedule(new SwitchTimeoutTask(this, 10 * SECONDS));
+	net->schedule(make_ptr<SwitchTimeoutTask>(this, 10 * SECONDS));
 #ifdef UNDER_TEST
 	auto trans = SwitchTransaction();
 	trans.from = Callsign("UNKNOWN");
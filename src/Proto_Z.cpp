@@ -0,0 +1,144 @@
+/*
+ * LoRaMaDoR (LoRa-based mesh network for hams) project
+ * Copyright (c) 2019 PU5EPX
+ */
+
+/* Implementation of message compression (Z parameter)
+ *
+ * The sender asks for compression by adding the naked Z param. The
+ * message is compressed with a static dictionary of common substrings
+ * (SMAZ-style) before the packet is signed. If compression does not
+ * pay off, the message goes as is, and Z is removed.
+ *
+ * Compressed format: octets 0x00-0x7f are literal ASCII; 0x80-0xfe
+ * stand for dictionary entries; 0xff escapes the next octet, so any
+ * message can be represented.
+ */
+
+#include <string.h>
+#include "Proto_Z.h"
+#include "Network.h"
+#include "Packet.h"
+
+static const uint8_t Z_ESCAPE = 0xff;
+
+// Tuned for chat, APRS messages and the core protocols' payloads.
+// The wire format depends on this table; do not change existing entries.
+static const char *dictionary[] = {
+	" the ", " the", "the ", " and ", " and", "ing ", "ing", " to ", " of ", " is ",
+	" you", " in ", "tion", " for ", " on ", " a ", " at ", " be ", " are ", " have",
+	" this", " that", " with", " will", " from", " de ", " 73", "73", " CQ", " QSL",
+	" QTH", " QRZ", " TNX", "thanks", "hello", "good", " test", "test", " msg", "http",
+	"://", ".com", "www.", "aprs", "APRS", "LoRa", "MaDoR", "confirm ", "ping", "pong",
+	"up ", " -", "-1", "-2", "-9", "PU5", "PY", "PP", "KD", "N0",
+	"th", "he", "in", "er", "an", "re", "on", "at", "en", "nd",
+	"es", "or", "te", "ed", "ti", "is", "it", "ou", "ar", "st",
+	"al", "le", "ve", "ha", "ng", "as", "co", "me", "de", "to",
+	"se", "ne", "ea", "hi", "ll", "ro", "ri", "ce", "ma", "ly",
+	"ra", "li", "e ", "s ", "t ", "d ", "n ", "y ", "r ", "o ",
+	", ", ". ", "  ", "? ", "! ", "00", "10", "20", "19", "12",
+	"11", "01", "02", "05", "50", "25", " 1",
+};
+
+static const size_t DICT_SIZE = sizeof(dictionary) / sizeof(dictionary[0]);
+static_assert(DICT_SIZE <= (Z_ESCAPE - 0x80), "Compression dictionary too big");
+
+Proto_Z::Proto_Z(Network *net): L4Protocol(net)
+{
+}
+
+// Greedy compression, longest dictionary match first
+Buffer Proto_Z_compress(const Buffer& msg)
+{
+	const char *s = msg.c_str();
+	size_t len = msg.length();
+	Buffer out;
+	out.reserve(len);
+
+	size_t i = 0;
+	while (i < len) {
+		size_t best = DICT_SIZE;
+		size_t best_len = 1;
+		for (size_t j = 0; j < DICT_SIZE; ++j) {
+			size_t dlen = strlen(dictionary[j]);
+			if (dlen > best_len && dlen <= (len - i)
+					&& memcmp(s + i, dictionary[j], dlen) == 0) {
+				best = j;
+				best_len = dlen;
+			}
+		}
+
+		if (best < DICT_SIZE) {
+			out += (char) (0x80 + best);
+		} else if ((uint8_t) s[i] >= 0x80) {
+			out += (char) Z_ESCAPE;
+			out += s[i];
+		} else {
+			out += s[i];
+		}
+		i += best_len;
+	}
+
+	return out;
+}
+
+// Returns false if the compressed data is malformed
+bool Proto_Z_decompress(const Buffer& z, Buffer& msg)
+{
+	const uint8_t *s = (const uint8_t*) z.c_str();
+	size_t len = z.length();
+	msg = Buffer();
+	msg.reserve(len * 2);
+
+	for (size_t i = 0; i < len; ++i) {
+		uint8_t c = s[i];
+		if (c < 0x80) {
+			msg += (char) c;
+		} else if (c == Z_ESCAPE) {
+			if (++i >= len) {
+				return false;
+			}
+			msg += (char) s[i];
+		} else if ((size_t) (c - 0x80) < DICT_SIZE) {
+			msg += dictionary[c - 0x80];
+		} else {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+L4rxHandlerResponse Proto_Z::rx(const Packet& pkt)
+{
+	if (! pkt.params().has("Z")) {
+		return L4rxHandlerResponse();
+	}
+
+	Buffer msg;
+	if (! Proto_Z_decompress(pkt.msg(), msg)) {
+		return L4rxHandlerResponse(false, Callsign(), Params(), "",
+				true, "bad compressed msg");
+	}
+
+	// next protocols and the application see the original message
+	return L4rxHandlerResponse(pkt.change_msg(msg));
+}
+
+L4txHandlerResponse Proto_Z::tx(const Packet& pkt)
+{
+	if (! pkt.params().has("Z") || pkt.params().has("F")) {
+		// fragments are sent again as they are
+		return L4txHandlerResponse();
+	}
+
+	Buffer z = Proto_Z_compress(pkt.msg());
+	if (z.length() >= pkt.msg().length()) {
+		// does not pay off
+		Params p = pkt.params();
+		p.remove("Z");
+		return L4txHandlerResponse(pkt.change_params(p));
+	}
+
+	return L4txHandlerResponse(pkt.change_msg(z));
+}
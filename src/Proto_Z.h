@@ -0,0 +1,30 @@
+/*
+ * LoRaMaDoR (LoRa-based mesh network for hams) project
+ * Copyright (c) 2019 PU5EPX
+ */
+
+// Implementation of message compression (Z parameter)
+
+#ifndef __PROTO_Z_H
+#define __PROTO_Z_H
+
+#include "L4Protocol.h"
+#include "Buffer.h"
+
+class Proto_Z: public L4Protocol {
+public:
+	Proto_Z(Network* net);
+	virtual L4txHandlerResponse tx(const Packet&);
+	virtual L4rxHandlerResponse rx(const Packet&);
+
+	Proto_Z() = delete;
+	Proto_Z(const Proto_Z&) = delete;
+	Proto_Z(Proto_Z&&) = delete;
+	Proto_Z& operator=(const Proto_Z&) = delete;
+	Proto_Z& operator=(Proto_Z&&) = delete;
+};
+
+Buffer Proto_Z_compress(const Buffer&);
+bool Proto_Z_decompress(const Buffer&, Buffer&);
+
+#endif
@@ -0,0 +1,158 @@
+/*
+ * LoRaMaDoR (LoRa-based mesh network for hams) project
+ * Copyright (c) 2019 PU5EPX
+ */
+
+/* Log of received packets, used to detect and discard duplicates.
+ *
+ * A packet is identified by (source callsign, packet ID). The log is
+ * a fixed-size open-addressing hash table, so lookup and insertion
+ * are O(1) and do not allocate memory. Slots are indexed by the
+ * callsign hash but matched by the packed callsign itself.
+ *
+ * Expiry is done in time buckets ("generations"). New entries always
+ * go to the current generation. Every 'persist' milliseconds, the
+ * previous generation is wiped out and the current one takes its
+ * place. Lookups check both generations, and the timestamp of each
+ * entry is still honored, so an entry is visible for exactly 'persist'
+ * milliseconds. Cleaning is a single pass over a flat array, no
+ * need to walk through keys and build remove lists.
+ *
+ * If the current generation fills up before its time, it is rotated
+ * early. It means some entries are forgotten earlier than they should,
+ * but the memory usage is bounded.
+ */
+
+#include "RecvLog.h"
+#include "Timestamp.h"
+#include "Config.h"
+
+static_assert((RECV_LOG_SIZE & (RECV_LOG_SIZE - 1)) == 0,
+		"RECV_LOG_SIZE must be a power of 2");
+
+// Maximum occupation of a generation before early rotation
+static const size_t RECV_LOG_MAX_LOAD = RECV_LOG_SIZE * 3 / 4;
+
+RecvLogItem::RecvLogItem(int rssi, int64_t timestamp):
+	rssi(rssi), timestamp(timestamp), hmac(0), dups(0)
+{}
+
+RecvLogItem::RecvLogItem(): hmac(0), dups(0)
+{}
+
+RecvLog::RecvLog(int64_t persist):
+	persist(persist), gen_start(sys_timestamp())
+{
+	for (size_t g = 0; g < 2; ++g) {
+		gen[g] = new Slot[RECV_LOG_SIZE];
+		for (size_t i = 0; i < RECV_LOG_SIZE; ++i) {
+			// ident 0 = empty slot (packet IDs are never 0)
+			gen[g][i].ident = 0;
+		}
+		gen_count[g] = 0;
+	}
+}
+
+RecvLog::~RecvLog()
+{
+	delete [] gen[0];
+	delete [] gen[1];
+}
+
+static size_t slot_index(uint32_t key, uint32_t ident)
+{
+	return (key ^ (ident * 2654435761u)) & (RECV_LOG_SIZE - 1);
+}
+
+// Linear probing. Returns the slot holding (from, ident), or the empty
+// slot where it should be inserted.
+const RecvLog::Slot* RecvLog::find(const Slot* g, const Callsign& from, uint32_t ident) const
+{
+	size_t i = slot_index(from.hash(), ident);
+	// load factor < 1 guarantees there is always an empty slot
+	while (g[i].ident) {
+		if (g[i].ident == ident && g[i].from == from) {
+			break;
+		}
+		i = (i + 1) & (RECV_LOG_SIZE - 1);
+	}
+	return &g[i];
+}
+
+bool RecvLog::has(const Callsign& from, uint32_t ident, int64_t now) const
+{
+	for (size_t g = 0; g < 2; ++g) {
+		const Slot* s = find(gen[g], from, ident);
+		if (s->ident && (s->item.timestamp + persist) >= now) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Lookup by callsign not yet decoded (view into a received packet)
+bool RecvLog::has(const BufferView& from, uint32_t ident, int64_t now) const
+{
+	return has(Callsign(from), ident, now);
+}
+
+// Entry of a packet, or 0 if not found. Allows to annotate the entry.
+RecvLogItem* RecvLog::get(const Callsign& from, uint32_t ident, int64_t now)
+{
+	for (size_t g = 0; g < 2; ++g) {
+		Slot* s = const_cast<Slot*>(find(gen[g], from, ident));
+		if (s->ident && (s->item.timestamp + persist) >= now) {
+			return &s->item;
+		}
+	}
+	return 0;
+}
+
+RecvLogItem* RecvLog::get(const BufferView& from, uint32_t ident, int64_t now)
+{
+	return get(Callsign(from), ident, now);
+}
+
+void RecvLog::put(const Callsign& from, uint32_t ident, const RecvLogItem& item)
+{
+	if (gen_count[0] >= RECV_LOG_MAX_LOAD) {
+		rotate(item.timestamp);
+	}
+
+	Slot* s = const_cast<Slot*>(find(gen[0], from, ident));
+	if (! s->ident) {
+		s->from = from;
+		s->ident = ident;
+		++gen_count[0];
+	}
+	s->item = item;
+}
+
+// Discard the previous generation, current becomes previous.
+void RecvLog::rotate(int64_t now)
+{
+	Slot* old = gen[1];
+	gen[1] = gen[0];
+	gen_count[1] = gen_count[0];
+
+	for (size_t i = 0; i < RECV_LOG_SIZE; ++i) {
+		old[i].ident = 0;
+	}
+	gen[0] = old;
+	gen_count[0] = 0;
+	gen_start = now;
+}
+
+// Called periodically to expire old entries
+void RecvLog::clean(int64_t now)
+{
+	if ((gen_start + persist) <= now) {
+		rotate(now);
+	}
+}
+
+// Number of entries, including those already expired but not cleaned up
+size_t RecvLog::count() const
+{
+	return gen_count[0] + gen_count[1];
+}
@@ -0,0 +1,65 @@
+/*
+ * LoRaMaDoR (LoRa-based mesh network for hams) project
+ * Copyright (c) 2019 PU5EPX
+ */
+
+// Log of received packets, used to detect and discard duplicates
+
+#ifndef __RECVLOG_H
+#define __RECVLOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include "Callsign.h"
+#include "BufferView.h"
+
+struct RecvLogItem {
+	RecvLogItem(int rssi, int64_t timestamp);
+	RecvLogItem();
+	int rssi;
+	int64_t timestamp;
+	// memoized HMAC verification outcome, 0 = not verified
+	uint8_t hmac;
+	// duplicate copies heard afterwards
+	uint8_t dups;
+};
+
+class RecvLog {
+public:
+	RecvLog(int64_t persist);
+	~RecvLog();
+
+	bool has(const Callsign& from, uint32_t ident, int64_t now) const;
+	bool has(const BufferView& from, uint32_t ident, int64_t now) const;
+	void put(const Callsign& from, uint32_t ident, const RecvLogItem&);
+	RecvLogItem* get(const Callsign& from, uint32_t ident, int64_t now);
+	RecvLogItem* get(const BufferView& from, uint32_t ident, int64_t now);
+	void clean(int64_t now);
+	size_t count() const;
+
+private:
+	// The callsign is stored, not only its hash, so two stations
+	// whose hashes collide are never mistaken for each other
+	struct Slot {
+		Callsign from;
+		uint32_t ident;
+		RecvLogItem item;
+	};
+
+	const Slot* find(const Slot* gen, const Callsign& from, uint32_t ident) const;
+	void rotate(int64_t now);
+
+	int64_t persist;
+	int64_t gen_start;
+	// current and previous generations, RECV_LOG_SIZE slots each
+	Slot* gen[2];
+	size_t gen_count[2];
+
+	RecvLog() = delete;
+	RecvLog(const RecvLog&) = delete;
+	RecvLog(RecvLog&&) = delete;
+	RecvLog& operator=(const RecvLog&) = delete;
+	RecvLog& operator=(RecvLog&&) = delete;
+};
+
+#endif
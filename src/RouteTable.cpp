@@ -0,0 +1,387 @@
+/*
+ * LoRaMaDoR (LoRa-based mesh network for hams) project
+ * Copyright (c) 2019 PU5EPX
+ */
+
+/* Table of radio links between stations, used to find unicast routes.
+ * Port of the router of the Python simulator (_pocs_/simulator/adv).
+ *
+ * Each edge is a link heard by a station, with cost -RSSI, so a path
+ * with fewer and stronger hops is cheaper. Edges are learned from
+ * packets heard directly from the source, and from the hop lists that
+ * RREQ and RRSP packets accumulate. Edges expire after 'persist'
+ * milliseconds unless heard again.
+ *
+ * The first hop towards each destination is found by Dijkstra's
+ * algorithm from this station, and cached until the edges change.
+ * The table has a fixed capacity; when full, the edge closest to
+ * expiry is replaced.
+ *
+ * Complete paths to stations that answered our RREQs are also kept,
+ * to be used as source routes.
+ *
+ * When delivery through the known route fails, the source route is
+ * dropped and the destination is marked to be reached by diffusion,
+ * until the mark expires or a new RRSP brings a fresh path.
+ */
+
+#include <cstdlib>
+#include "RouteTable.h"
+#include "Callsign.h"
+
+static const int NO_ROUTE = 0x7fffffff;
+static const size_t NONE = (size_t) -1;
+
+RouteTable::Edge::Edge(const Buffer& to, const Buffer& from, int cost, int64_t expiry):
+	to(to), from(from), cost(cost), expiry(expiry)
+{}
+
+RouteTable::Hop::Hop(const Buffer& via, int cost):
+	via(via), cost(cost)
+{}
+
+RouteTable::Hop::Hop(): cost(NO_ROUTE)
+{}
+
+RouteTable::SourceRoute::SourceRoute(const Buffer& hops, int64_t expiry):
+	hops(hops), expiry(expiry)
+{}
+
+RouteTable::SourceRoute::SourceRoute(): expiry(0)
+{}
+
+RouteTable::RouteTable(size_t capacity, int64_t persist):
+	capacity(capacity), persist(persist), dirty(true)
+{
+}
+
+// Annotate that station 'to' has heard 'from' with a given RSSI
+void RouteTable::add_edge(const Buffer& to, const Buffer& from, int rssi, int64_t now)
+{
+	if (to == from) {
+		return;
+	}
+
+	int cost = rssi < 0 ? -rssi : 1;
+	size_t oldest = 0;
+
+	for (size_t i = 0; i < _edges.count(); ++i) {
+		Edge& e = _edges[i];
+		if (e.to == to && e.from == from) {
+			if (e.cost != cost) {
+				dirty = true;
+			}
+			e.cost = cost;
+			e.expiry = now + persist;
+			return;
+		}
+		if (e.expiry < _edges[oldest].expiry) {
+			oldest = i;
+		}
+	}
+
+	if (_edges.count() >= capacity) {
+		_edges.erase(oldest);
+	}
+	_edges.push_back(Edge(to, from, cost, now + persist));
+	dirty = true;
+}
+
+/* Parse the hops accumulated in the message of a RREQ or RRSP packet:
+   a sequence of "CALLSIGN RSSI" pairs, where each station heard the
+   previous one. The station that answered the RREQ is marked with '*',
+   its index goes to 'answered' (or hop count if not found). Returns
+   false if the message is not a valid hop list. */
+bool RouteTable::parse_path(const Buffer& path, Vector<Buffer>& hops,
+			Vector<int>& rssis, size_t& answered)
+{
+	const char *s = path.c_str();
+	answered = NONE;
+
+	while (*s) {
+		while (*s == ' ') {
+			++s;
+		}
+		if (! *s) {
+			break;
+		}
+		if (*s == '*') {
+			answered = hops.count();
+			++s;
+		}
+
+		const char *cs = s;
+		while (*s && *s != ' ') {
+			++s;
+		}
+		Callsign hop(BufferView(cs, s - cs));
+		if (! hop.is_valid()) {
+			return false;
+		}
+
+		while (*s == ' ') {
+			++s;
+		}
+		const char *r = s;
+		if (*s == '-') {
+			++s;
+		}
+		if (*s < '0' || *s > '9') {
+			return false;
+		}
+		while (*s >= '0' && *s <= '9') {
+			++s;
+		}
+		if (*s && *s != ' ') {
+			return false;
+		}
+
+		hops.push_back(Buffer(hop));
+		rssis.push_back(atoi(r));
+	}
+
+	if (answered == NONE) {
+		answered = hops.count();
+	}
+	return true;
+}
+
+/* Learn the hops of a RREQ or RRSP packet. 'start' is the station that
+   originated the RREQ, 'me' is the station that heard the last hop with
+   'rssi'. Returns false if the message is not a valid hop list. */
+bool RouteTable::add_path(const Buffer& start, const Buffer& path,
+			const Buffer& me, int rssi, int64_t now)
+{
+	Vector<Buffer> hops;
+	Vector<int> rssis;
+	size_t answered;
+
+	if (! parse_path(path, hops, rssis, answered)) {
+		return false;
+	}
+
+	Buffer prev = start;
+	for (size_t i = 0; i < hops.count(); ++i) {
+		add_edge(hops[i], prev, rssis[i], now);
+		prev = hops[i];
+	}
+	add_edge(me, prev, rssi, now);
+	return true;
+}
+
+/* Keep the forward path of a RRSP that answered our RREQ, to be used
+   as source route: the repeaters between us and the answering station,
+   in a form suitable for the S parameter (e.g. "PU5AAA-1/PU5BBB"). */
+bool RouteTable::add_source_route(const Buffer& path, int64_t now)
+{
+	Vector<Buffer> hops;
+	Vector<int> rssis;
+	size_t answered;
+
+	if (! parse_path(path, hops, rssis, answered) || answered >= hops.count()) {
+		return false;
+	}
+	if (answered > SOURCE_ROUTE_MAX_HOPS) {
+		return false;
+	}
+
+	Buffer sroute;
+	for (size_t i = 0; i < answered; ++i) {
+		if (i) {
+			sroute += '/';
+		}
+		sroute += hops[i];
+	}
+
+	const Buffer& dest = hops[answered];
+	if (! sroutes.has(dest) && sroutes.count() >= SOURCE_ROUTES) {
+		// replace the route closest to expiry
+		size_t oldest = 0;
+		for (size_t i = 1; i < sroutes.count(); ++i) {
+			if (sroutes[sroutes.keys()[i]].expiry <
+					sroutes[sroutes.keys()[oldest]].expiry) {
+				oldest = i;
+			}
+		}
+		sroutes.remove(Buffer(sroutes.keys()[oldest]));
+	}
+	sroutes[dest] = SourceRoute(sroute, now + persist);
+	failures.remove(dest);
+	return true;
+}
+
+// Source route to a destination (empty if direct or unknown)
+Buffer RouteTable::source_route(const Buffer& to) const
+{
+	if (! sroutes.has(to)) {
+		return Buffer();
+	}
+	return sroutes[to].hops;
+}
+
+// Delivery to a destination through the known route failed
+void RouteTable::fail(const Buffer& to, int64_t now)
+{
+	if (! failures.has(to) && failures.count() >= FAILED_ROUTES) {
+		// replace the mark closest to expiry
+		size_t oldest = 0;
+		for (size_t i = 1; i < failures.count(); ++i) {
+			if (failures[failures.keys()[i]] < failures[failures.keys()[oldest]]) {
+				oldest = i;
+			}
+		}
+		failures.remove(Buffer(failures.keys()[oldest]));
+	}
+	failures[to] = now + persist;
+	sroutes.remove(to);
+}
+
+// Whether a destination should be reached by diffusion
+bool RouteTable::failed(const Buffer& to) const
+{
+	return failures.has(to);
+}
+
+// First hop of a source route
+Buffer RouteTable::first_hop(const Buffer& sroute)
+{
+	int slash = sroute.indexOf('/');
+	if (slash < 0) {
+		return sroute;
+	}
+	return sroute.substr(0, slash);
+}
+
+// Source route without the first hop
+Buffer RouteTable::rest_hops(const Buffer& sroute)
+{
+	int slash = sroute.indexOf('/');
+	if (slash < 0) {
+		return Buffer();
+	}
+	return sroute.substr(slash + 1);
+}
+
+// Forget edges, source routes and failures not heard for a while
+void RouteTable::expire(int64_t now)
+{
+	for (size_t i = _edges.count(); i > 0; --i) {
+		if (_edges[i-1].expiry < now) {
+			_edges.erase(i-1);
+			dirty = true;
+		}
+	}
+
+	Vector<Buffer> remove_list;
+	for (size_t i = 0; i < sroutes.count(); ++i) {
+		const Buffer& dest = sroutes.keys()[i];
+		if (sroutes[dest].expiry < now) {
+			remove_list.push_back(dest);
+		}
+	}
+	for (size_t i = 0; i < remove_list.count(); ++i) {
+		sroutes.remove(remove_list[i]);
+	}
+
+	remove_list.clear();
+	for (size_t i = 0; i < failures.count(); ++i) {
+		const Buffer& dest = failures.keys()[i];
+		if (failures[dest] < now) {
+			remove_list.push_back(dest);
+		}
+	}
+	for (size_t i = 0; i < remove_list.count(); ++i) {
+		failures.remove(remove_list[i]);
+	}
+}
+
+// Dijkstra's shortest paths from 'me', keeping the first hop of each
+void RouteTable::compute(const Buffer& me)
+{
+	Vector<Buffer> nodes;
+	Vector<int> dist;
+	Vector<int> first;
+	Vector<bool> done;
+
+	nodes.push_back(me);
+	for (size_t i = 0; i < _edges.count(); ++i) {
+		const Buffer* ends[2] = {&_edges[i].to, &_edges[i].from};
+		for (size_t j = 0; j < 2; ++j) {
+			bool found = false;
+			for (size_t k = 0; k < nodes.count() && ! found; ++k) {
+				found = nodes[k] == *ends[j];
+			}
+			if (! found) {
+				nodes.push_back(*ends[j]);
+			}
+		}
+	}
+	for (size_t k = 0; k < nodes.count(); ++k) {
+		dist.push_back(k ? NO_ROUTE : 0);
+		first.push_back(-1);
+		done.push_back(false);
+	}
+
+	while (true) {
+		int u = -1;
+		for (size_t k = 0; k < nodes.count(); ++k) {
+			if (! done[k] && dist[k] != NO_ROUTE && (u < 0 || dist[k] < dist[u])) {
+				u = k;
+			}
+		}
+		if (u < 0) {
+			break;
+		}
+		done[u] = true;
+
+		for (size_t i = 0; i < _edges.count(); ++i) {
+			const Edge& e = _edges[i];
+			if (e.from != nodes[u]) {
+				continue;
+			}
+			for (size_t v = 0; v < nodes.count(); ++v) {
+				if (nodes[v] != e.to) {
+					continue;
+				}
+				if (dist[u] + e.cost < dist[v]) {
+					dist[v] = dist[u] + e.cost;
+					first[v] = u ? first[u] : v;
+				}
+				break;
+			}
+		}
+	}
+
+	_hops = Dict<Hop>();
+	for (size_t v = 1; v < nodes.count(); ++v) {
+		if (first[v] >= 0) {
+			_hops[nodes[v]] = Hop(nodes[first[v]], dist[v]);
+		}
+	}
+	hops_origin = me;
+	dirty = false;
+}
+
+// First hops to all reachable destinations
+const Dict<RouteTable::Hop>& RouteTable::hops(const Buffer& me)
+{
+	if (dirty || hops_origin != me) {
+		compute(me);
+	}
+	return _hops;
+}
+
+// Next station towards 'to', or empty if there is no known route
+Buffer RouteTable::next_hop(const Buffer& me, const Buffer& to)
+{
+	const Dict<Hop>& h = hops(me);
+	if (! h.has(to)) {
+		return Buffer();
+	}
+	return h[to].via;
+}
+
+const Vector<RouteTable::Edge>& RouteTable::edges() const
+{
+	return _edges;
+}
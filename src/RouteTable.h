@@ -0,0 +1,90 @@
+/*
+ * LoRaMaDoR (LoRa-based mesh network for hams) project
+ * Copyright (c) 2019 PU5EPX
+ */
+
+// Table of radio links between stations, used to find unicast routes
+
+#ifndef __ROUTETABLE_H
+#define __ROUTETABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include "Vector.h"
+#include "Dict.h"
+#include "Buffer.h"
+
+class RouteTable {
+public:
+	// Link 'from' -> 'to', as heard by 'to'
+	struct Edge {
+		Edge(const Buffer& to, const Buffer& from, int cost, int64_t expiry);
+		Buffer to;
+		Buffer from;
+		int cost;
+		int64_t expiry;
+	};
+
+	// First hop towards a destination
+	struct Hop {
+		Hop(const Buffer& via, int cost);
+		Hop();
+		Buffer via;
+		int cost;
+	};
+
+	// Complete path to a destination
+	struct SourceRoute {
+		SourceRoute(const Buffer& hops, int64_t expiry);
+		SourceRoute();
+		Buffer hops;
+		int64_t expiry;
+	};
+
+	static const size_t SOURCE_ROUTES = 16;
+	static const size_t SOURCE_ROUTE_MAX_HOPS = 6;
+	static const size_t FAILED_ROUTES = 16;
+
+	RouteTable(size_t capacity, int64_t persist);
+
+	void add_edge(const Buffer& to, const Buffer& from, int rssi, int64_t now);
+	bool add_path(const Buffer& start, const Buffer& path, const Buffer& me,
+			int rssi, int64_t now);
+	bool add_source_route(const Buffer& path, int64_t now);
+	Buffer source_route(const Buffer& to) const;
+	void fail(const Buffer& to, int64_t now);
+	bool failed(const Buffer& to) const;
+	static Buffer first_hop(const Buffer& sroute);
+	static Buffer rest_hops(const Buffer& sroute);
+	static bool parse_path(const Buffer& path, Vector<Buffer>& hops,
+			Vector<int>& rssis, size_t& answered);
+	void expire(int64_t now);
+	Buffer next_hop(const Buffer& me, const Buffer& to);
+	const Dict<Hop>& hops(const Buffer& me);
+	const Vector<Edge>& edges() const;
+
+private:
+	void compute(const Buffer& me);
+
+	size_t capacity;
+	int64_t persist;
+	Vector<Edge> _edges;
+
+	// first hops from 'hops_origin', recomputed when edges change
+	Dict<Hop> _hops;
+	Buffer hops_origin;
+	bool dirty;
+
+	Dict<SourceRoute> sroutes;
+
+	// destinations to reach by diffusion, with expiry time
+	Dict<int64_t> failures;
+
+	RouteTable() = delete;
+	RouteTable(const RouteTable&) = delete;
+	RouteTable(RouteTable&&) = delete;
+	RouteTable& operator=(const RouteTable&) = delete;
+	RouteTable& operator=(RouteTable&&) = delete;
+};
+
+#endif
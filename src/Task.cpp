@@ -14,6 +14,11 @@
  * return 0 (meaning the task is finished) or a positive offset
  * (meaning the task should be rescheduled to now + offset).
  *
+ * Pending tasks are kept in a binary min-heap ordered by next_run(),
+ * so scheduling and expiry are O(log n) and finding the earliest
+ * deadline is O(1). Tasks with the same deadline run in the order
+ * they were scheduled, e.g. packets sent one after the other.
+ *
  * The task manager lives inside the Network class, so the
  * main loop calls a Network method periodically, which
  * calls the task manager.
@@ -24,7 +29,7 @@
 #include "Timestamp.h"
 
 Task::Task(const char *name, int64_t offset):
-	name(name), offset(offset), timebase(0)
+	name(name), offset(offset), timebase(0), heap_pos(0), heap_seq(0)
 {
 }
 
@@ -64,14 +69,12 @@ bool Task::run(int64_t now)
 	return this->offset > 0;
 }
 
-/*
 Buffer Task::get_name() const
 {
 	return name;
 }
-*/
 
-TaskManager::TaskManager() {}
+TaskManager::TaskManager(): seq(0) {}
 
 TaskManager::~TaskManager()
 {
@@ -85,67 +88,133 @@ void TaskManager::stop()
 
 void TaskManager::schedule(Ptr<Task> task)
 {
-	Ptr<Task> etask = task;
-	tasks.push_back(etask);
-	etask->set_timebase(sys_timestamp());
+	task->set_timebase(sys_timestamp());
+	heap_push(task);
 }
 
 Ptr<Task> TaskManager::next_task() const
 {
-	Ptr<Task> ret(0);
-	int64_t task_time = sys_timestamp() + 60 * 1000;
-	for (size_t i = 0 ; i < tasks.count(); ++i) {
-		Ptr<Task> t = tasks[i];
-		if (! t->cancelled()) {
-			int64_t nr = t->next_run();
-			if (nr < task_time) {
-				task_time = nr;
-				ret = t;
-			}
-		}
+	if (! tasks.count()) {
+		return Ptr<Task>(0);
 	}
-	return ret;
+	Ptr<Task> t = tasks[0];
+	if (t->next_run() >= (sys_timestamp() + MAX_IDLE_TIME)) {
+		return Ptr<Task>(0);
+	}
+	return t;
 }
 
-/*
+// Milliseconds until the earliest task is due (0 if overdue)
+int64_t TaskManager::next_deadline(int64_t now) const
+{
+	if (! tasks.count()) {
+		return MAX_IDLE_TIME;
+	}
+	int64_t deadline = tasks[0]->next_run() - now;
+	if (deadline < 0) {
+		return 0;
+	} else if (deadline > MAX_IDLE_TIME) {
+		return MAX_IDLE_TIME;
+	}
+	return deadline;
+}
+
+// Remove a pending task. No effect if the task is not scheduled.
 void TaskManager::cancel(const Task* task)
 {
-	for (size_t i = 0 ; i < tasks.count(); ++i) {
-		if (tasks[i].id() == task) {
-			tasks.remov(i);
-			break;
-		}
+	size_t pos = task->heap_pos;
+	if (pos < tasks.count() && tasks[pos].id() == task) {
+		heap_remove(pos);
 	}
 }
-*/
 
 void TaskManager::run(int64_t now)
 {
-	bool dirty = false;
-
-	for (size_t i = 0 ; i < tasks.count(); ++i) {
-		Ptr<Task> t = tasks[i];
-		if (t->should_run(now)) {
-			bool stay = t->run(now);
-			if (stay) {
-				// reschedule
-				t->set_timebase(sys_timestamp());
-			} else {
-				// task list must be pruned
-				dirty = true;
-			}
+	while (tasks.count() && tasks[0]->should_run(now)) {
+		Ptr<Task> t = tasks[0];
+		heap_remove(0);
+		bool stay = t->run(now);
+		if (stay) {
+			// reschedule; timebase never behind 'now' so
+			// the task is not run twice in the same call
+			int64_t timebase = sys_timestamp();
+			t->set_timebase(timebase > now ? timebase : now);
+			heap_push(t);
+		}
+	}
+}
+
+void TaskManager::heap_swap(size_t a, size_t b)
+{
+	Ptr<Task> t = tasks[a];
+	tasks[a] = tasks[b];
+	tasks[b] = t;
+	tasks[a]->heap_pos = a;
+	tasks[b]->heap_pos = b;
+}
+
+// Task at heap position a must run before the one at b
+bool TaskManager::earlier(size_t a, size_t b) const
+{
+	int64_t ra = tasks[a]->next_run();
+	int64_t rb = tasks[b]->next_run();
+	if (ra != rb) {
+		return ra < rb;
+	}
+	// wraparound-safe comparison of sequence numbers
+	return (int32_t) (tasks[a]->heap_seq - tasks[b]->heap_seq) < 0;
+}
+
+void TaskManager::sift_up(size_t pos)
+{
+	while (pos > 0) {
+		size_t parent = (pos - 1) / 2;
+		if (! earlier(pos, parent)) {
+			break;
 		}
+		heap_swap(parent, pos);
+		pos = parent;
 	}
+}
 
-	while (dirty) {
-		dirty = false;
-		for (size_t i = 0 ; i < tasks.count(); ++i) {
-			Ptr<Task> t = tasks[i];
-			if (t->cancelled()) {
-				tasks.remov(i);
-				dirty = true;
-				break;
-			}
+void TaskManager::sift_down(size_t pos)
+{
+	size_t n = tasks.count();
+	while (true) {
+		size_t smallest = pos;
+		size_t l = 2 * pos + 1;
+		size_t r = l + 1;
+		if (l < n && earlier(l, smallest)) {
+			smallest = l;
 		}
+		if (r < n && earlier(r, smallest)) {
+			smallest = r;
+		}
+		if (smallest == pos) {
+			break;
+		}
+		heap_swap(smallest, pos);
+		pos = smallest;
+	}
+}
+
+void TaskManager::heap_push(Ptr<Task> task)
+{
+	task->heap_seq = seq++;
+	task->heap_pos = tasks.count();
+	tasks.push_back(task);
+	sift_up(task->heap_pos);
+}
+
+void TaskManager::heap_remove(size_t pos)
+{
+	size_t last = tasks.count() - 1;
+	if (pos != last) {
+		heap_swap(pos, last);
+	}
+	tasks.remov(last);
+	if (pos < tasks.count()) {
+		sift_down(pos);
+		sift_up(pos);
 	}
 }
@@ -13,6 +13,10 @@
 #include "Vector.h"
 #include "Buffer.h"
 #include "Pointer.h"
+#include "Timestamp.h"
+
+// Longest sleep of the main loop; also the period of tasks with nothing to do
+static const int64_t MAX_IDLE_TIME = 60 * SECONDS;
 
 class TaskManager;
 
@@ -36,6 +40,10 @@ private:
 	Buffer name;
 	int64_t offset;
 	int64_t timebase;
+	// position in task manager heap
+	size_t heap_pos;
+	// order of scheduling, breaks ties between equal deadlines
+	uint32_t heap_seq;
 
 	// Tasks must be manipulated through (smart) pointers,
 	// the pointer is the ID, no copies allowed
@@ -56,10 +64,20 @@ public:
 	void run(int64_t);
 	void schedule(Ptr<Task> task);
 	void cancel(const Task* task);
+	int64_t next_deadline(int64_t now) const;
 	// for testing purposes
 	Ptr<Task> next_task() const;
 private:
+	void heap_push(Ptr<Task>);
+	void heap_remove(size_t pos);
+	void heap_swap(size_t, size_t);
+	void sift_up(size_t pos);
+	void sift_down(size_t pos);
+	bool earlier(size_t a, size_t b) const;
+
+	// binary min-heap ordered by Task::next_run(), then by scheduling order
 	Vector< Ptr<Task> > tasks;
+	uint32_t seq;
 
 	TaskManager(const TaskManager&) = delete;
 	TaskManager(const TaskManager&&) = delete;
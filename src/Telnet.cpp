@@ -84,6 +84,12 @@ Buffer get_wifi_status()
 	return status;
 }
 
+// Wi-Fi is configured (connected or not)
+bool wifi_enabled()
+{
+	return wifi_status != 0;
+}
+
 // called periodically by Arduino loop()
 void wifi_handle()
 {
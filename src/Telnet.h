@@ -12,6 +12,7 @@ class Network;
 
 void wifi_setup(Ptr<Network>);
 void wifi_handle();
+bool wifi_enabled();
 void telnet_print(const char *);
 Buffer get_wifi_status();
 
@@ -0,0 +1,142 @@
+/*
+ * LoRaMaDoR (LoRa-based mesh network for hams) project
+ * Copyright (c) 2019 PU5EPX
+ */
+
+/* Bounded priority queue of frames waiting for transmission.
+ *
+ * Every outbound frame goes through this single queue, owned by
+ * Network, instead of each frame being a task that polls the radio.
+ * Each frame has a priority and a due time (relays are delayed on
+ * purpose, to mitigate collisions). The next frame to send is the
+ * highest-priority frame already due; ties are broken by arrival
+ * order.
+ *
+ * When the queue is full, the oldest beacon is dropped to make room;
+ * failing that, the oldest relayed frame (but not for a beacon). Other
+ * frames originated by this station are never dropped, a new frame is
+ * refused instead if there is nothing to drop.
+ *
+ * The queue is short, so linear scans are cheap enough.
+ */
+
+#include "TxQueue.h"
+
+TxQueue::Item::Item(const Buffer& frame, Priority prio, int64_t due, uint32_t seq,
+		uint32_t key, uint32_t ident):
+	frame(frame), prio(prio), due(due), seq(seq), key(key), ident(ident)
+{}
+
+TxQueue::TxQueue(size_t capacity):
+	_capacity(capacity), seq(0), _peak(0), _dropped(0)
+{
+	items.reserve(capacity);
+}
+
+// Drop the oldest frame of a given priority, if any.
+bool TxQueue::drop_oldest(Priority prio)
+{
+	for (size_t i = 0; i < items.count(); ++i) {
+		// items are kept in arrival order
+		if (items[i].prio == prio) {
+			items.erase(i);
+			++_dropped;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Queue a frame, to be sent not before 'due'. Relayed frames pass the
+// packet identification (see cancel()), ident 0 = not cancellable.
+// Returns false if the queue is full and the frame was refused.
+bool TxQueue::push(const Buffer& frame, Priority prio, int64_t due,
+			uint32_t key, uint32_t ident)
+{
+	if (items.count() >= _capacity) {
+		bool room = drop_oldest(BEACON);
+		if (! room && prio < BEACON) {
+			room = drop_oldest(RELAY);
+		}
+		if (! room) {
+			++_dropped;
+			return false;
+		}
+	}
+
+	items.push_back(Item(frame, prio, due, seq++, key, ident));
+	if (items.count() > _peak) {
+		_peak = items.count();
+	}
+	return true;
+}
+
+// Find the frame to be sent now. If there is none, returns false and
+// 'wait' receives the time until the next frame is due (or -1 if the
+// queue is empty).
+bool TxQueue::next(int64_t now, size_t& index, int64_t& wait) const
+{
+	bool found = false;
+	wait = -1;
+	for (size_t i = 0; i < items.count(); ++i) {
+		const Item& item = items[i];
+		if (item.due > now) {
+			if (wait < 0 || (item.due - now) < wait) {
+				wait = item.due - now;
+			}
+			continue;
+		}
+		// items are in arrival order, so only a higher priority wins
+		if (! found || item.prio < items[index].prio) {
+			index = i;
+			found = true;
+		}
+	}
+	return found;
+}
+
+// Withdraw a pending relay, e.g. because other repeaters already did it
+bool TxQueue::cancel(uint32_t key, uint32_t ident)
+{
+	if (! ident) {
+		return false;
+	}
+	for (size_t i = 0; i < items.count(); ++i) {
+		if (items[i].ident == ident && items[i].key == key) {
+			items.erase(i);
+			return true;
+		}
+	}
+	return false;
+}
+
+const Buffer& TxQueue::frame(size_t index) const
+{
+	return items[index].frame;
+}
+
+void TxQueue::remove(size_t index)
+{
+	items.erase(index);
+}
+
+size_t TxQueue::count() const
+{
+	return items.count();
+}
+
+size_t TxQueue::capacity() const
+{
+	return _capacity;
+}
+
+size_t TxQueue::peak() const
+{
+	return _peak;
+}
+
+// Frames dropped or refused because the queue was full
+size_t TxQueue::dropped() const
+{
+	return _dropped;
+}
@@ -0,0 +1,68 @@
+/*
+ * LoRaMaDoR (LoRa-based mesh network for hams) project
+ * Copyright (c) 2019 PU5EPX
+ */
+
+// Bounded priority queue of frames waiting for transmission
+
+#ifndef __TXQUEUE_H
+#define __TXQUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include "Buffer.h"
+#include "Vector.h"
+
+class TxQueue {
+public:
+	// Lower value = sent first
+	enum Priority {
+		CONTROL = 0,	// automatic responses (PONG, RRSP, CO)
+		LOCAL,		// originated by this station
+		RELAY,		// forwarded on behalf of others
+		BEACON		// beacons, ours or relayed
+	};
+
+	struct Item {
+		Item(const Buffer& frame, Priority prio, int64_t due, uint32_t seq,
+			uint32_t key, uint32_t ident);
+		Buffer frame;
+		Priority prio;
+		int64_t due;
+		uint32_t seq;
+		// identifies a relayed packet (source callsign hash, ID)
+		uint32_t key;
+		uint32_t ident;
+	};
+
+	explicit TxQueue(size_t capacity);
+
+	bool push(const Buffer& frame, Priority prio, int64_t due,
+			uint32_t key = 0, uint32_t ident = 0);
+	bool cancel(uint32_t key, uint32_t ident);
+	bool next(int64_t now, size_t& index, int64_t& wait) const;
+	const Buffer& frame(size_t index) const;
+	void remove(size_t index);
+
+	size_t count() const;
+	size_t capacity() const;
+	size_t peak() const;
+	size_t dropped() const;
+
+private:
+	bool drop_oldest(Priority prio);
+
+	Vector<Item> items;
+	size_t _capacity;
+	uint32_t seq;
+	size_t _peak;
+	size_t _dropped;
+
+	TxQueue() = delete;
+	TxQueue(const TxQueue&) = delete;
+	TxQueue(TxQueue&&) = delete;
+	TxQueue& operator=(const TxQueue&) = delete;
+	TxQueue& operator=(TxQueue&&) = delete;
+};
+
+#endif
@@ -3,80 +3,91 @@
 // Zac Staples
 // zacstaples (at) mac (dot) com
 //
-// Light implementation of a vector or list
+// Light implementation of a vector or list.
+// Elements are stored contiguously in a single block.
 
 #ifndef __VECTOR_H
 #define __VECTOR_H
 
 #include <stddef.h>
 #include <string.h>
+#include <new>
+#include <utility>
 
 template<class T>
 class Vector {
 	size_t sz;
-	T** elem;
+	T* elem;
 	size_t space;
 
 public:
 	Vector() : sz(0), elem(0), space(0) {}
-	Vector(const int s) : sz(0) {
+	Vector(const int s) : sz(0), elem(0), space(0) {
 		reserve(s);
 	}
-	
+
 	Vector& operator=(const Vector&);
 	Vector& operator=(Vector&&);
 	Vector(const Vector&);
 	Vector(Vector&&);
-	
-	~Vector() { 
+
+	~Vector() {
 		clear();
 	}
-	
+
 	void clear();
-	T& operator[](size_t n) { return *elem[n]; }
-	const T& operator[](size_t n) const { return *elem[n]; }
-	
+	T& operator[](size_t n) { return elem[n]; }
+	const T& operator[](size_t n) const { return elem[n]; }
+
+	T* begin() { return elem; }
+	T* end() { return elem + sz; }
+	const T* begin() const { return elem; }
+	const T* end() const { return elem + sz; }
+
 	size_t count() const { return sz; }
 	size_t capacity() const { return space; }
-	
+
 	void reserve(size_t newalloc);
 	void push_back(const T& val);
+	void push_back(T&& val);
+	template<class... Args> T& emplace_back(Args&&... args);
 	void remov(size_t pos);
+	void erase(size_t pos);
 	void insert(size_t pos, const T& val);
+	void insert(size_t pos, T&& val);
+
+private:
+	void grow();
 };
 
-template<class T> 
+template<class T>
 Vector<T>& Vector<T>::operator=(const Vector& a) {
 	if (this==&a) return *this;
 
 	clear();
-
-	// new array
-	elem = new T*[a.count()];
-	space = sz = a.count();
+	reserve(a.count());
 
 	// copy elements
-	for(size_t i=0; i < sz; ++i) {
-		elem[i] = new T(a[i]);
+	for(size_t i=0; i < a.count(); ++i) {
+		new (elem + i) T(a[i]);
 	}
+	sz = a.count();
 
 	return *this;
 }
 
-template<class T> 
-Vector<T>::Vector(const Vector& a) {
-	if (this==&a) return;
-
-	elem = new T*[a.count()];
-	space = sz = a.count();
+template<class T>
+Vector<T>::Vector(const Vector& a) : sz(0), elem(0), space(0) {
+	reserve(a.count());
 
 	// copy elements
-	for(size_t i=0; i < sz; ++i) {
-		elem[i] = new T(a[i]);
+	for(size_t i=0; i < a.count(); ++i) {
+		new (elem + i) T(a[i]);
 	}
+	sz = a.count();
 }
 
-template<class T> 
+template<class T>
 Vector<T>::Vector(Vector&& a) {
 	elem = a.elem;
 	space = a.space;
@@ -87,16 +98,16 @@ Vector<T>::Vector(Vector&& a) {
 	a.sz = 0;
 }
 
-template<class T> 
+template<class T>
 void Vector<T>::clear()
 {
-	for (size_t i=0; i<sz; ++i) delete elem[i];
-	delete [] elem;
+	for (size_t i=0; i<sz; ++i) elem[i].~T();
+	::operator delete(elem);
 	elem = 0;
 	sz = space = 0;
 }
 
-template<class T> 
+template<class T>
 Vector<T>& Vector<T>::operator=(Vector&& a) {
 	if(this==&a) return *this;
 
@@ -104,61 +115,94 @@ Vector<T>& Vector<T>::operator=(Vector&& a) {
 
 	elem = a.elem;
 	sz = a.sz;
-	space = a.sz;
+	space = a.space;
 
 	a.elem = 0;
 	a.sz = 0;
 	a.space = 0;
+
+	return *this;
 }
 
 template<class T> void Vector<T>::reserve(size_t newalloc){
 	if(newalloc <= space) return;
 
-	T** p = new T*[newalloc];
-	if (elem) {
-		memcpy(p, elem, sizeof(T*) * sz);
-		delete [] elem;
+	T* p = static_cast<T*>(::operator new(sizeof(T) * newalloc));
+	// move elements to new block
+	for (size_t i = 0; i < sz; ++i) {
+		new (p + i) T(std::move(elem[i]));
+		elem[i].~T();
 	}
+	::operator delete(elem);
 	elem = p;
-	space = newalloc;	
+	space = newalloc;
+}
+
+template<class T> void Vector<T>::grow() {
+	if(space == 0) reserve(4);				//start small
+	else if(sz==space) reserve(2*space);
 }
 
 template<class T> void
-Vector<T>::remov(size_t pos){
-	if (pos >= 0 && pos < sz) {
-		delete elem[pos];
-		--sz;
-		// move pointers
-		for (size_t i = pos; i < sz; ++i) {
-			elem[i] = elem[i+1];
+Vector<T>::erase(size_t pos){
+	if (pos < sz) {
+		// move elements
+		for (size_t i = pos; i + 1 < sz; ++i) {
+			elem[i] = std::move(elem[i+1]);
 		}
+		--sz;
+		elem[sz].~T();
 	}
 }
 
-template<class T> 
+template<class T> void
+Vector<T>::remov(size_t pos){
+	erase(pos);
+}
+
+template<class T>
 void Vector<T>::push_back(const T& val){
-	if(space == 0) reserve(4);				//start small
-	else if(sz==space) reserve(2*space);
-	elem[sz] = new T(val);
+	// val may be an element of this very vector
+	T copy(val);
+	push_back(std::move(copy));
+}
+
+template<class T>
+void Vector<T>::push_back(T&& val){
+	grow();
+	new (elem + sz) T(std::move(val));
 	++sz;
 }
 
-template<class T> 
+template<class T> template<class... Args>
+T& Vector<T>::emplace_back(Args&&... args){
+	grow();
+	new (elem + sz) T(std::forward<Args>(args)...);
+	return elem[sz++];
+}
+
+template<class T>
 void Vector<T>::insert(size_t pos, const T& val){
-	if (pos >= sz || pos < 0) {
-		push_back(val);
+	T copy(val);
+	insert(pos, std::move(copy));
+}
+
+template<class T>
+void Vector<T>::insert(size_t pos, T&& val){
+	if (pos >= sz) {
+		push_back(std::move(val));
 		return;
 	}
 
-	if(space == 0) reserve(4);
-	else if(sz==space) reserve(2*space);
+	grow();
 
-	// move pointers
-	for (size_t i = sz; i > pos; --i) {
-		elem[i] = elem[i-1];
+	// move elements
+	new (elem + sz) T(std::move(elem[sz-1]));
+	for (size_t i = sz - 1; i > pos; --i) {
+		elem[i] = std::move(elem[i-1]);
 	}
 	++sz;
-	elem[pos] = new T(val);
+	elem[pos] = std::move(val);
 }
 
 #endif
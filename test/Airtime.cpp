@@ -0,0 +1 @@
+../src/Airtime.cpp
\ No newline at end of file
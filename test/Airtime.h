@@ -0,0 +1 @@
+../src/Airtime.h
\ No newline at end of file
@@ -0,0 +1 @@
+../src/BufferView.h
\ No newline at end of file
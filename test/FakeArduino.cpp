@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -48,6 +49,11 @@ void arduino_restart() {
 	exit(0);
 }
 
+void arduino_light_sleep(int64_t ms)
+{
+	usleep(ms * 1000);
+}
+
 void oled_show(const char *, const char *, const char *, const char*)
 {
 }
@@ -0,0 +1 @@
+../src/PacketId.cpp
\ No newline at end of file
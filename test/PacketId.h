@@ -0,0 +1 @@
+../src/PacketId.h
\ No newline at end of file
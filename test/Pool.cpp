@@ -0,0 +1 @@
+../src/Pool.cpp
\ No newline at end of file
@@ -0,0 +1 @@
+../src/Pool.h
\ No newline at end of file
@@ -61,3 +61,12 @@ void Preferences::putString(const char* key, const char* value)
 {
 	nvram[key] = value;
 }
+
+bool Preferences::remove(const char* key)
+{
+	if (!nvram.has(key)) {
+		return false;
+	}
+	nvram.remove(key);
+	return true;
+}
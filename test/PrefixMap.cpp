@@ -0,0 +1 @@
+../src/PrefixMap.cpp
\ No newline at end of file
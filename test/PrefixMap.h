@@ -0,0 +1 @@
+../src/PrefixMap.h
\ No newline at end of file
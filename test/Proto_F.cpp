@@ -0,0 +1 @@
+../src/Proto_F.cpp
\ No newline at end of file
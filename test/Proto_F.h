@@ -0,0 +1 @@
+../src/Proto_F.h
\ No newline at end of file
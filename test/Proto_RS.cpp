@@ -0,0 +1 @@
+../src/Proto_RS.cpp
\ No newline at end of file
@@ -0,0 +1 @@
+../src/Proto_RS.h
\ No newline at end of file
@@ -0,0 +1 @@
+../src/Proto_Z.cpp
\ No newline at end of file
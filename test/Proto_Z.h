@@ -0,0 +1 @@
+../src/Proto_Z.h
\ No newline at end of file
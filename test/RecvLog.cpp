@@ -0,0 +1 @@
+../src/RecvLog.cpp
\ No newline at end of file
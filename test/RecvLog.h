@@ -0,0 +1 @@
+../src/RecvLog.h
\ No newline at end of file
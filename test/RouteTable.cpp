@@ -0,0 +1 @@
+../src/RouteTable.cpp
\ No newline at end of file
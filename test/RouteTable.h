@@ -0,0 +1 @@
+../src/RouteTable.h
\ No newline at end of file
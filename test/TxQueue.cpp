@@ -0,0 +1 @@
+../src/TxQueue.cpp
\ No newline at end of file
@@ -0,0 +1 @@
+../src/TxQueue.h
\ No newline at end of file
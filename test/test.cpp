@@ -11,6 +11,17 @@
 #include "HMACKeys.h"
 #include "Preferences.h"
 #include "NVRAM.h"
+#include "RecvLog.h"
+#include "Timestamp.h"
+#include "Config.h"
+#include "PrefixMap.h"
+#include "Airtime.h"
+#include "TxQueue.h"
+#include "RouteTable.h"
+#include "Modf_R.h"
+#include "Proto_Z.h"
+#include "Proto_F.h"
+#include "Proto_RS.h"
 
 void test1()
 {
@@ -116,6 +127,29 @@ void test2() {
 
 	assert(strcmp(q->msg().c_str(), "bla ble") == 0);
 	assert(strcmp(r->msg().c_str(), "bla") == 0);
+
+	// wire form is cached, received packets keep the original bytes
+	assert(p->encoded() == "AAAA<BBBB:133,A,B=C bla");
+	assert(q->encoded() == "AAAA<BBBB:133,A,B=C bla ble");
+	assert(r->encoded() == "AAAA<BBBB:133,A,B=C,E,F=G bla");
+	assert(r->encode_l3(10) == "AAAA<BBBB:");
+	assert(&r->encoded() == &r->encoded());
+
+	Ptr<Packet> s = p->add_naked_param("r");
+	assert(s->encoded() == "AAAA<BBBB:133,A,B=C,R bla");
+	assert(s->params().is_key_naked("R"));
+	s = s->change_msg("x");
+	assert(s->encoded() == "AAAA<BBBB:133,A,B=C,R x");
+	s = s->add_naked_param("B");
+	assert(s->params().is_key_naked("B"));
+	assert(s->encoded() == "AAAA<BBBB:133,A,B,R x");
+
+	p = Packet::decode_l3_test("aaaa<bbbb:133,", error);
+	s = p->add_naked_param("R");
+	assert(s->encoded() == "aaaa<bbbb:133,R");
+	assert(Packet::decode_l3_test(s->encoded().c_str(), error)->params().has("R"));
+	s = s->change_msg("");
+	assert(s->encoded() == "aaaa<bbbb:133,R ");
 }
 
 void test3()
@@ -198,6 +232,34 @@ void test4()
 	assert(Buffer("aaa").substr(5, 1).length() == 0);
 	assert(Buffer("aaa").substr(2, 20).length() == 1);
 
+	// inline and heap storage, geometric growth
+	Buffer g = "0123456789";
+	g += g;
+	g += g;
+	assert(g.length() == 40);
+	assert(g.startsWith("01234567890123456789"));
+	g.append(g.c_str() + 30, 10);
+	assert(g.length() == 50);
+	assert(g.substr(40) == "0123456789");
+	g.cut(45);
+	assert(g == "56789");
+	Buffer h = std::move(g);
+	assert(h == "56789");
+	assert(g.empty());
+	assert(g == "");
+	g = "x";
+	for (int i = 0; i < 100; ++i) {
+		g += 'y';
+	}
+	assert(g.length() == 101);
+	h = std::move(g);
+	assert(h.length() == 101);
+	assert(g.empty());
+	h = "short";
+	assert(h == "short");
+	h.reserve(200);
+	assert(h == "short");
+
 	Vector<Buffer> a;
 	a.push_back(Buffer("B"));
 	a.push_back(Buffer("C"));
@@ -206,6 +268,29 @@ void test4()
 	assert(a.count() == 2);
 	assert(a[0] == "B");
 	assert(a[1] == "D");
+
+	a.emplace_back("E", 1);
+	a.insert(0, Buffer("A"));
+	a.insert(2, a[0]);
+	a.insert(10, "F");
+	Buffer all;
+	for (const Buffer& b: a) {
+		all += b;
+	}
+	assert(all == "ABADEF");
+	a.erase(2);
+	a.erase(10);
+	assert(a.count() == 5);
+
+	Vector<Buffer> b = a;
+	Vector<Buffer> c = std::move(a);
+	assert(a.count() == 0);
+	assert(b.count() == 5);
+	assert(c[4] == "F");
+	c = std::move(b);
+	assert(c.count() == 5);
+	c = c;
+	assert(c[0] == "A");
 }
 
 void test5()
@@ -237,6 +322,1332 @@ void test5()
 	assert(a.indexOf("Z") == 4);
 }
 
+void test6()
+{
+	RecvLog log(10 * 60 * 1000);
+	Callsign a("AAAA");
+	Callsign b("BBBB-1");
+	int64_t t0 = sys_timestamp();
+
+	assert(!log.has(a, 1, t0));
+	log.put(a, 1, RecvLogItem(-50, t0));
+	assert(log.has(a, 1, t0));
+	assert(!log.has(a, 2, t0));
+	assert(!log.has(b, 1, t0));
+	log.put(a, 1, RecvLogItem(-50, t0));
+	assert(log.count() == 1);
+
+	// callsigns with the same hash are told apart
+	Callsign c1("XKRZCA");
+	Callsign c2("D6CADA");
+	assert(c1.hash() == c2.hash());
+	log.put(c1, 5, RecvLogItem(-50, t0));
+	assert(log.has(c1, 5, t0));
+	assert(!log.has(c2, 5, t0));
+	assert(!log.get(BufferView("D6CADA", 6), 5, t0));
+	log.put(c2, 5, RecvLogItem(-60, t0));
+	assert(log.get(c2, 5, t0)->rssi == -60);
+	assert(log.get(c1, 5, t0)->rssi == -50);
+
+	// entries can be annotated, e.g. with HMAC verdict
+	assert(log.get(a, 1, t0)->hmac == 0);
+	log.get(a, 1, t0)->hmac = 2;
+	assert(log.get(a, 1, t0)->hmac == 2);
+	assert(log.get(a, 1, t0)->rssi == -50);
+	assert(log.get(BufferView("aaaa", 4), 1, t0)->dups == 0);
+	++log.get(a, 1, t0)->dups;
+	assert(log.get(BufferView("AAAA", 4), 1, t0)->dups == 1);
+	assert(!log.get(a, 2, t0));
+	assert(!log.get(a, 1, t0 + 10 * 60 * 1000 + 1));
+
+	// expiry honors the timestamp of each entry
+	assert(log.has(a, 1, t0 + 10 * 60 * 1000));
+	assert(!log.has(a, 1, t0 + 10 * 60 * 1000 + 1));
+
+	// entries survive one rotation, not two
+	log.clean(t0 + 60 * 60 * 1000);
+	log.put(b, 7, RecvLogItem(-50, t0 + 60 * 60 * 1000));
+	log.clean(t0 + 70 * 60 * 1000);
+	assert(log.has(b, 7, t0 + 70 * 60 * 1000));
+	log.clean(t0 + 80 * 60 * 1000);
+	assert(!log.has(b, 7, t0 + 70 * 60 * 1000));
+
+	// overflow rotates early, memory stays bounded
+	for (uint32_t i = 1; i <= RECV_LOG_SIZE * 2; ++i) {
+		log.put(a, i, RecvLogItem(-50, t0));
+		assert(log.has(a, i, t0));
+	}
+	assert(log.count() <= RECV_LOG_SIZE * 2);
+}
+
+static Buffer task_trace;
+
+class TestTask: public Task {
+public:
+	TestTask(const char *name, int64_t offset, int64_t period):
+		Task(name, offset), period(period)
+	{
+	}
+protected:
+	virtual int64_t run2(int64_t now) {
+		task_trace += get_name();
+		return period;
+	}
+private:
+	int64_t period;
+};
+
+void test7()
+{
+	TaskManager mgr;
+	assert(!mgr.next_task());
+
+	mgr.schedule(make_ptr<TestTask>("c", 3000, 0));
+	mgr.schedule(make_ptr<TestTask>("a", 1000, 0));
+	mgr.schedule(make_ptr<TestTask>("p", 1500, 5000));
+	mgr.schedule(make_ptr<TestTask>("b", 2000, 0));
+	mgr.schedule(make_ptr<TestTask>("z", 90000, 0));
+	assert(mgr.next_task()->get_name() == "a");
+	int64_t deadline = mgr.next_deadline(sys_timestamp());
+	assert(deadline > 0 && deadline <= 1000);
+	assert(mgr.next_deadline(sys_timestamp() + 5000) == 0);
+
+	int64_t now = sys_timestamp();
+	mgr.run(now + 500);
+	assert(task_trace == "");
+	mgr.run(now + 2500);
+	assert(task_trace == "apb");
+	// periodic task is not run twice in the same call
+	mgr.run(now + 4000);
+	assert(task_trace == "apbc");
+	mgr.run(now + 10000);
+	assert(task_trace == "apbcp");
+	// only z (too far away) and p are left
+	assert(!mgr.next_task() || mgr.next_task()->get_name() == "p");
+
+	// cancel pending tasks, in any position of the heap
+	Ptr<Task> x = make_ptr<TestTask>("x", 100, 0);
+	Ptr<Task> y = make_ptr<TestTask>("y", 200, 0);
+	mgr.schedule(x);
+	mgr.schedule(y);
+	mgr.schedule(make_ptr<TestTask>("w", 300, 0));
+	mgr.cancel(x.id());
+	mgr.cancel(x.id());
+	mgr.run(sys_timestamp() + 250);
+	assert(task_trace == "apbcpy");
+	// no effect on task already run
+	mgr.cancel(y.id());
+	mgr.run(sys_timestamp() + 350);
+	assert(task_trace == "apbcpyw");
+
+	// same deadline: run in scheduling order
+	task_trace = "";
+	const char *names[] = {"0", "1", "2", "3", "4", "5", "6", "7", "8", "9"};
+	for (size_t i = 0; i < 10; ++i) {
+		mgr.schedule(make_ptr<TestTask>(names[i], 0, 0));
+	}
+	mgr.run(sys_timestamp() + 1);
+	assert(task_trace == "0123456789");
+}
+
+void test8()
+{
+	// packet data is not NUL-terminated, the trailing digits must be ignored
+	const char *raw = "aaaa<bbbb-1:123,x,y=456 msg7890";
+	int error;
+	BufferView from;
+	uint32_t ident;
+
+	assert(Packet::check_l3(raw, 23, from, ident, error));
+	assert(from == "bbbb-1");
+	assert(ident == 123);
+
+	assert(Packet::check_l3(raw, 14, from, ident, error));
+	assert(ident == 12);
+	assert(!Packet::check_l3(raw, 12, from, ident, error));
+	assert(error == 105);
+	assert(!Packet::check_l3(raw, 9, from, ident, error));
+	assert(error == 100);
+	assert(!Packet::check_l3("aaaa<b:1", 8, from, ident, error));
+	assert(error == 104);
+
+	Ptr<Packet> p = Packet::decode_l3(raw, 27, -50, error);
+	assert(!!p);
+	assert(p->to() == "AAAA");
+	assert(p->from() == "BBBB-1");
+	assert(p->params().ident() == 123);
+	assert(p->params().is_key_naked("x"));
+	assert(p->params().get("y") == "456");
+	assert(p->msg() == "msg");
+
+	assert(!Params::check(BufferView("0123", 4), ident));
+	assert(!Params::check(BufferView("1234567", 7), ident));
+	assert(Params::check(BufferView("1234567", 6), ident));
+	assert(ident == 123456);
+	assert(!Params::check(BufferView("12,a b", 6), ident));
+
+	BufferView v("abcdef", 6);
+	assert(v.substr(2, 10) == "cdef");
+	assert(v.substr(7, 1).empty());
+	assert(v.str() == "abcdef");
+
+	// duplicates are found from the undecoded callsign
+	RecvLog log(10 * 60 * 1000);
+	int64_t t0 = sys_timestamp();
+	log.put(Callsign("BBBB-1"), 123, RecvLogItem(-50, t0));
+	assert(log.has(BufferView("bbbb-1", 6), 123, t0));
+	assert(log.has(BufferView("BBBB-1", 6), 123, t0));
+	assert(!log.has(BufferView("BBBB-2", 6), 123, t0));
+}
+
+static int ptr_alive = 0;
+
+class PtrBase {
+public:
+	PtrBase(int v): v(v) { ++ptr_alive; }
+	virtual ~PtrBase() { --ptr_alive; }
+	int v;
+};
+
+class PtrDerived: public PtrBase {
+public:
+	PtrDerived(int v, int w): PtrBase(v), w(w) {}
+	int w;
+};
+
+void test9()
+{
+	Ptr<PtrBase> n;
+	assert(!n);
+	assert(!Ptr<PtrBase>(0));
+
+	{
+		Ptr<PtrDerived> d = make_ptr<PtrDerived>(1, 2);
+		assert(ptr_alive == 1);
+		assert(d->v == 1 && d->w == 2);
+
+		Ptr<PtrBase> b = d;
+		assert(b.id() == d.id());
+		Ptr<PtrBase> c = std::move(b);
+		assert(!b);
+		assert(c->v == 1);
+
+		n = c;
+		c = Ptr<PtrBase>();
+		d = Ptr<PtrDerived>();
+		assert(ptr_alive == 1);
+		n = n;
+		assert(ptr_alive == 1);
+		n = Ptr<PtrBase>(new PtrBase(3));
+		assert(ptr_alive == 1);
+		assert(n->v == 3);
+	}
+
+	n = Ptr<PtrBase>();
+	assert(ptr_alive == 0);
+
+	Vector< Ptr<PtrBase> > v;
+	for (int i = 0; i < 10; ++i) {
+		v.push_back(make_ptr<PtrDerived>(i, i));
+	}
+	v.erase(3);
+	assert(ptr_alive == 9);
+	assert(v[3]->v == 4);
+	v.clear();
+	assert(ptr_alive == 0);
+}
+
+void test10()
+{
+	Pool pool("test", sizeof(PtrPooled<PtrDerived>), 2);
+	{
+		Ptr<PtrBase> a = make_pooled_ptr<PtrDerived>(pool, 1, 1);
+		Ptr<PtrDerived> b = make_pooled_ptr<PtrDerived>(pool, 2, 2);
+		assert(a && b);
+		assert(pool.used() == 2);
+		assert(!make_pooled_ptr<PtrDerived>(pool, 3, 3));
+		assert(pool.dropped() == 1);
+		assert(ptr_alive == 2);
+		a = Ptr<PtrBase>();
+		assert(pool.used() == 1);
+		Ptr<PtrDerived> c = make_pooled_ptr<PtrDerived>(pool, 4, 4);
+		assert(c->w == 4);
+		assert(b->w == 2);
+	}
+	assert(pool.used() == 0);
+	assert(pool.peak() == 2);
+	assert(ptr_alive == 0);
+
+	Pool ppool("packet", sizeof(PtrPooled<Packet>), 1);
+	int error = 0;
+	Ptr<Packet> p = Packet::decode_l3("AAAA<BBBB:1 a", 13, -50, error, &ppool);
+	assert(!!p);
+	assert(!Packet::decode_l3("AAAA<BBBB:2 b", 13, -50, error, &ppool));
+	assert(error == 106);
+	p = Ptr<Packet>();
+	p = Packet::decode_l3("AAAA<BBBB:3 c", 13, -50, error, &ppool);
+	assert(p->msg() == "c");
+}
+
+void test11()
+{
+	arduino_nvram_id_save(MAX_PACKET_ID - 150);
+	Vector<uint32_t> ids;
+
+	// simulated restarts after a varying number of packets
+	for (uint32_t run = 0; run < 8; ++run) {
+		PacketId alloc;
+		for (uint32_t i = 0; i < run * 37; ++i) {
+			uint32_t id = alloc.next();
+			assert(id >= 1 && id <= MAX_PACKET_ID);
+			assert(alloc.last() == id);
+			// NVRAM is only written once per block
+			assert(arduino_nvram_id_load() >= id);
+			assert(arduino_nvram_id_load() - id < PACKET_ID_BLOCK);
+			ids.push_back(id);
+		}
+	}
+
+	// IDs never repeat (the sequence wraps around once)
+	size_t wraps = 0;
+	for (size_t i = 1; i < ids.count(); ++i) {
+		if (ids[i] <= ids[i-1]) {
+			++wraps;
+			assert(ids[i] < ids[0]);
+		}
+	}
+	assert(wraps == 1);
+	assert(ids[0] == MAX_PACKET_ID - 149);
+}
+
+void test12()
+{
+	PrefixMap map;
+	assert(!map.longest_match("PU5EPX", 6));
+	map.put("PU5", "a");
+	map.put("PU5EPX", "b");
+	map.put("PU5EPX-1", "c");
+	map.put("PY", "d");
+	map.put("PU5", "e");
+	assert(map.count() == 4);
+	assert(*map.longest_match("PU5EPX-1", 8) == "c");
+	assert(*map.longest_match("PU5EPX-11", 9) == "c");
+	assert(*map.longest_match("PU5EPX-2", 8) == "b");
+	assert(*map.longest_match("PU5EP", 5) == "e");
+	assert(*map.longest_match("PY2XYZ", 6) == "d");
+	assert(!map.longest_match("PP5AAA", 6));
+	assert(!map.longest_match("P", 1));
+	map.put("", "z");
+	assert(*map.longest_match("PP5AAA", 6) == "z");
+	map.clear();
+	assert(!map.longest_match("PU5EPX", 6));
+
+	// keys loaded from NVRAM
+	arduino_nvram_hmac_psk_save("global");
+	arduino_nvram_hmac_key_save("PU5", "state");
+	arduino_nvram_hmac_key_save("PU5EPX", "station");
+	assert(HMACKeys::get_key_for(Callsign("PU5EPX-1")) == HMACKeys::hash_key("station"));
+	assert(HMACKeys::get_key_for(Callsign("PU5ABC")) == HMACKeys::hash_key("state"));
+	assert(HMACKeys::get_key_for(Callsign("PY2ABC")) == HMACKeys::hash_key("global"));
+	arduino_nvram_hmac_key_save("PU5EPX", "");
+	assert(arduino_nvram_hmac_keys_load().count() == 1);
+	// no stale entries left behind
+	assert(arduino_nvram_load("hk.p1") == "None");
+	assert(arduino_nvram_load("hk.k1") == "None");
+	assert(HMACKeys::get_key_for(Callsign("PU5EPX-1")) == HMACKeys::hash_key("state"));
+	arduino_nvram_hmac_psk_save("");
+	arduino_nvram_hmac_key_save("PU5", "");
+	assert(HMACKeys::get_key_for(Callsign("PU5EPX-1")).empty());
+}
+
+void test13()
+{
+	// 2700 bps: 100 octets take ~297ms
+	assert(Airtime::of(100, 2700) == 297);
+
+	// 10% duty cycle, 1000ms burst
+	Airtime a(10, 1000, 0);
+	assert(a.wait_time(500, 0) == 0);
+	a.used(500, 0);
+	assert(a.wait_time(500, 0) == 0);
+	a.used(500, 0);
+	// bucket empty, refills 1ms of airtime each 10ms
+	assert(a.wait_time(300, 0) == 3000);
+	assert(a.wait_time(300, 2000) == 1000);
+	assert(a.wait_time(300, 3000) == 0);
+	assert(a.deferred() == 0);
+	a.used(300, 3000);
+	// one frame deferred, even if retried twice
+	assert(a.deferred() == 1);
+	// frame bigger than bucket waits for full bucket only
+	assert(a.wait_time(5000, 13000) == 0);
+
+	assert(a.last_minute(3000) == 1300);
+	assert(a.last_hour(3000) == 1300);
+	a.used(100, 61 * SECONDS);
+	assert(a.last_minute(61 * SECONDS) == 100);
+	assert(a.last_hour(61 * SECONDS) == 1400);
+	assert(a.last_hour(3601 * SECONDS) == 100);
+	assert(a.last_hour(3661 * SECONDS) == 0);
+
+	// unlimited duty cycle
+	Airtime u(100, 1000, 0);
+	assert(u.wait_time(100000, 0) == 0);
+}
+
+void test14()
+{
+	TxQueue q(3);
+	size_t i;
+	int64_t wait;
+	assert(!q.next(0, i, wait));
+	assert(wait == -1);
+
+	assert(q.push("relay1", TxQueue::RELAY, 500));
+	assert(q.push("beacon", TxQueue::BEACON, 0));
+	assert(q.push("local", TxQueue::LOCAL, 0));
+	assert(q.next(0, i, wait));
+	assert(q.frame(i) == "local");
+	q.remove(i);
+	assert(q.next(0, i, wait));
+	assert(q.frame(i) == "beacon");
+	// relay not due yet
+	assert(q.push("control", TxQueue::CONTROL, 0));
+	assert(q.next(100, i, wait));
+	assert(q.frame(i) == "control");
+	assert(wait == 400);
+	q.remove(i);
+	assert(q.next(600, i, wait));
+	assert(q.frame(i) == "relay1");
+
+	// full: beacon dropped first, then oldest relay
+	assert(q.push("relay2", TxQueue::RELAY, 0));
+	assert(q.count() == 3);
+	assert(q.push("local2", TxQueue::LOCAL, 0));
+	assert(q.count() == 3);
+	assert(q.dropped() == 1);
+	assert(q.push("control2", TxQueue::CONTROL, 0));
+	assert(q.next(600, i, wait));
+	assert(q.frame(i) == "control2");
+	q.remove(i);
+	assert(q.next(600, i, wait));
+	assert(q.frame(i) == "local2");
+	q.remove(i);
+	assert(q.push("local3", TxQueue::LOCAL, 0));
+	assert(q.push("beacon2", TxQueue::BEACON, 0));
+	assert(q.push("beacon3", TxQueue::BEACON, 0));
+	assert(q.push("relay3", TxQueue::RELAY, 0));
+	assert(q.push("local4", TxQueue::LOCAL, 0));
+	assert(q.push("local5", TxQueue::LOCAL, 0));
+	// a beacon does not displace others
+	assert(!q.push("beacon4", TxQueue::BEACON, 0));
+	// nothing left to drop: refused
+	assert(!q.push("control3", TxQueue::CONTROL, 0));
+	assert(q.dropped() == 8);
+	assert(q.peak() == 3);
+	assert(q.next(600, i, wait));
+	assert(q.frame(i) == "local3");
+	q.remove(i);
+	assert(q.next(600, i, wait));
+	assert(q.frame(i) == "local4");
+
+	// withdraw pending relays
+	TxQueue r(4);
+	assert(r.push("local", TxQueue::LOCAL, 0));
+	assert(r.push("relay1", TxQueue::RELAY, 100, 0xaaaa, 1));
+	assert(r.push("relay2", TxQueue::RELAY, 100, 0xaaaa, 2));
+	assert(!r.cancel(0, 0));
+	assert(!r.cancel(0xbbbb, 1));
+	assert(r.cancel(0xaaaa, 1));
+	assert(!r.cancel(0xaaaa, 1));
+	assert(r.count() == 2);
+	assert(r.dropped() == 0);
+	assert(r.next(200, i, wait));
+	r.remove(i);
+	assert(r.next(200, i, wait));
+	assert(r.frame(i) == "relay2");
+}
+
+void test15()
+{
+	// relay delay weighted by RSSI, weaker = sooner
+	assert(Network::relay_backoff(1000, -30) == 1500);
+	assert(Network::relay_backoff(1000, RELAY_RSSI_NEAR) == 1500);
+	assert(Network::relay_backoff(1000, RELAY_RSSI_FAR) == 500);
+	assert(Network::relay_backoff(1000, -130) == 500);
+	int64_t last = 1500;
+	for (int rssi = RELAY_RSSI_NEAR; rssi >= RELAY_RSSI_FAR; --rssi) {
+		int64_t d = Network::relay_backoff(1000, rssi);
+		assert(d <= last && d >= 500);
+		last = d;
+	}
+	assert(Network::relay_backoff(0, -80) == 0);
+}
+
+void test16()
+{
+	RouteTable rt(8, 1000);
+	assert(rt.next_hop("AAAA", "BBBB").empty());
+
+	// AAAA hears BBBB and CCCC directly; DDDD only via the others
+	rt.add_edge("AAAA", "BBBB", -50, 0);
+	rt.add_edge("BBBB", "AAAA", -50, 0);
+	rt.add_edge("AAAA", "CCCC", -100, 0);
+	rt.add_edge("CCCC", "AAAA", -100, 0);
+	rt.add_edge("DDDD", "BBBB", -80, 0);
+	rt.add_edge("DDDD", "CCCC", -40, 0);
+	assert(rt.next_hop("AAAA", "BBBB") == "BBBB");
+	assert(rt.next_hop("AAAA", "CCCC") == "CCCC");
+	// 50 + 80 < 100 + 40
+	assert(rt.next_hop("AAAA", "DDDD") == "BBBB");
+	assert(rt.hops("AAAA")["DDDD"].cost == 130);
+	// weaker link
+	rt.add_edge("DDDD", "BBBB", -100, 0);
+	assert(rt.next_hop("AAAA", "DDDD") == "CCCC");
+	assert(rt.hops("AAAA")["DDDD"].cost == 140);
+	// unknown way back
+	assert(rt.next_hop("DDDD", "AAAA").empty());
+	assert(rt.edges().count() == 6);
+
+	// RREQ from AAAA answered by EEEE, RRSP heard back by AAAA
+	assert(rt.add_path("AAAA", "CCCC -60 *EEEE -70 FFFF -75 CCCC -65", "AAAA", -55, 500));
+	assert(rt.next_hop("AAAA", "EEEE") == "CCCC");
+	assert(rt.next_hop("CCCC", "AAAA") == "AAAA");
+	assert(rt.next_hop("EEEE", "AAAA") == "FFFF");
+	assert(!rt.add_path("AAAA", "CCCC -60 EEEE", "AAAA", -55, 500));
+	assert(!rt.add_path("AAAA", "CCCC x", "AAAA", -55, 500));
+	assert(!rt.add_path("AAAA", "C -60", "AAAA", -55, 500));
+	assert(rt.add_path("AAAA", "", "GGGG", -90, 500));
+	assert(rt.next_hop("AAAA", "GGGG") == "GGGG");
+	assert(rt.next_hop("GGGG", "AAAA").empty());
+
+	// table full: edges closest to expiry were replaced
+	assert(rt.edges().count() == 8);
+	assert(rt.next_hop("AAAA", "BBBB").empty());
+	assert(rt.next_hop("AAAA", "DDDD") == "CCCC");
+
+	// old edges expire, refreshed ones stay
+	rt.expire(1200);
+	assert(rt.edges().count() == 6);
+	assert(rt.next_hop("AAAA", "DDDD").empty());
+	assert(rt.next_hop("AAAA", "EEEE") == "CCCC");
+	rt.expire(1600);
+	assert(rt.edges().count() == 0);
+	assert(rt.next_hop("AAAA", "EEEE").empty());
+}
+
+void test17()
+{
+	RouteTable rt(8, 1000);
+	// RRSP that answered our RREQ, forward path BBBB, CCCC
+	assert(rt.add_source_route("BBBB -60 CCCC -70 *DDDD -80 CCCC -75 BBBB -65", 0));
+	assert(rt.source_route("DDDD") == "BBBB/CCCC");
+	assert(rt.source_route("CCCC").empty());
+	// direct neighbor
+	assert(rt.add_source_route("*EEEE -50", 0));
+	assert(rt.source_route("EEEE").empty());
+	// not an answer
+	assert(!rt.add_source_route("BBBB -60", 0));
+	assert(!rt.add_source_route("BBBB -60 *", 0));
+	rt.expire(500);
+	assert(rt.source_route("DDDD") == "BBBB/CCCC");
+	rt.expire(1001);
+	assert(rt.source_route("DDDD").empty());
+
+	assert(RouteTable::first_hop("BBBB/CCCC") == "BBBB");
+	assert(RouteTable::rest_hops("BBBB/CCCC") == "CCCC");
+	assert(RouteTable::first_hop("CCCC") == "CCCC");
+	assert(RouteTable::rest_hops("CCCC") == "");
+	assert(RouteTable::first_hop("") == "");
+
+	// R modifier consumes hops
+	Modf_R modf(0);
+	Params p;
+	p.set_ident(1);
+	p.put("S", "BBBB/CCCC");
+	Packet pkt(Callsign("DDDD"), Callsign("AAAA"), p, "msg");
+	Ptr<Packet> r1 = modf.modify(pkt);
+	assert(r1->params().get("S") == "CCCC");
+	assert(r1->params().has("R"));
+	Ptr<Packet> r2 = modf.modify(*r1);
+	assert(r2->params().has("S"));
+	assert(r2->params().get("S") == "");
+	assert(r2->encoded() == "DDDD<AAAA:1,R,S= msg");
+	int error;
+	Ptr<Packet> r3 = Packet::decode_l3_test(r2->encoded().c_str(), error);
+	assert(r3->params().get("S") == "");
+
+	// plain packets just get R
+	Params p2;
+	p2.set_ident(2);
+	Packet pkt2(Callsign("DDDD"), Callsign("AAAA"), p2, "msg");
+	assert(modf.modify(pkt2)->encoded() == "DDDD<AAAA:2,R msg");
+}
+
+void test18()
+{
+	int error;
+	BufferView from;
+	uint32_t ident;
+	char from_buf[Callsign::MAX_LEN];
+
+	// binary header round trip
+	Params p;
+	p.set_ident(300);
+	p.put_naked("R");
+	p.put_naked("PING");
+	p.put("H", "0123456789ab");
+	p.put("T", "12345");
+	p.put("E", "");
+	p.put_naked("X");
+	Packet pkt(Callsign("PU5EPX-11"), Callsign("aaaaaaa-99"), p, "msg");
+	Buffer b = pkt.encode_l3(200, true);
+	assert((uint8_t) b.charAt(0) == 0x80);
+	assert(b.length() < pkt.encoded().length());
+	assert(Packet::check_l3(b.c_str(), b.length(), from, ident, error, from_buf));
+	assert(from == "AAAAAAA-99");
+	assert(ident == 300);
+	assert(!Packet::check_l3(b.c_str(), b.length(), from, ident, error));
+
+	Ptr<Packet> q = Packet::decode_l3(b.c_str(), b.length(), -50, error);
+	assert(q->binary());
+	assert(q->to() == Callsign("PU5EPX-11"));
+	assert(q->from() == Callsign("AAAAAAA-99"));
+	assert(q->msg() == "msg");
+	assert(q->params().serialized() == pkt.params().serialized());
+	assert(q->encoded() == "PU5EPX-11<AAAAAAA-99:300,E=,H=0123456789ab,PING,R,T=12345,X msg");
+	assert(q->encode_l3(200, true) == b);
+	// modifiers work on the text form
+	assert(!q->add_naked_param("C")->binary());
+	assert(q->add_naked_param("C")->encode_l3(200, true).length() == b.length() + 1);
+
+	// H that is not hex, and no message
+	Params p2;
+	p2.set_ident(1);
+	p2.put("H", "0123456789AB");
+	Packet pkt2(Callsign("QC"), Callsign("BBBB"), p2, "");
+	Buffer b2 = pkt2.encode_l3(200, true);
+	Ptr<Packet> q2 = Packet::decode_l3(b2.c_str(), b2.length(), -50, error);
+	assert(q2->params().get("H") == "0123456789AB");
+	assert(q2->msg().empty());
+
+	// text and binary packets are told apart
+	Ptr<Packet> q3 = Packet::decode_l3_test("QC<BBBB:1,R bla", error);
+	assert(!q3->binary());
+
+	// malformed binary packets
+	for (size_t len = 1; len < b.length() - 3; ++len) {
+		assert(!Packet::check_l3(b.c_str(), len, from, ident, error, from_buf));
+		assert(!Packet::decode_l3(b.c_str(), len, -50, error));
+	}
+	Buffer bad = b;
+	bad = bad.substr(0, 1) + (char) 0 + bad.substr(2);
+	assert(!Packet::decode_l3(bad.c_str(), bad.length(), -50, error));
+	assert(error == 104);
+	Params p3;
+	p3.set_ident(1);
+	Buffer b3 = Packet(Callsign("QC"), Callsign("BBBB"), p3, "").encode_l3(200, true);
+	assert(b3.charAt(b3.length() - 1) == 0);
+	Buffer head = b3.substr(0, b3.length() - 1);
+	assert(Packet::decode_l3(b3.c_str(), b3.length(), -50, error));
+	// no end of params
+	assert(!Packet::decode_l3(head.c_str(), head.length(), -50, error));
+	assert(error == 105);
+	// unknown code
+	bad = head + (char) 0x33 + (char) 0;
+	assert(!Packet::decode_l3(bad.c_str(), bad.length(), -50, error));
+	assert(error == 105);
+	// generic param must be a single key
+	bad = head + (char) 0x21 + (char) 3 + "A,B" + (char) 0;
+	assert(!Packet::decode_l3(bad.c_str(), bad.length(), -50, error));
+	bad = head + (char) 0x21 + (char) 3 + "A=B" + (char) 0;
+	assert(Packet::decode_l3(bad.c_str(), bad.length(), -50, error)->params().get("A") == "B");
+	// packet ID 0
+	bad = b3.substr(0, b3.length() - 2) + (char) 0 + (char) 0;
+	assert(!Packet::decode_l3(bad.c_str(), bad.length(), -50, error));
+	assert(error == 105);
+
+	// airtime savings over a typical traffic mix
+	struct {
+		const char *to;
+		const char *from;
+		const char *params;
+		const char *msg;
+	} mix[] = {
+		{"QB", "PU5EPX-11", "1234", "LoRaMaDoR 1.0 uptime 1234s"},
+		{"QR", "PU5EPX-12", "1235,R", "LoRaMaDoR 1.0 uptime 456s"},
+		{"PY5XYZ", "PU5EPX-11", "1236,PING,H=0123456789ab", "ping"},
+		{"PU5EPX-11", "PY5XYZ", "77,PONG,R,H=0123456789ab", "ping"},
+		{"PY5XYZ", "PU5EPX-11", "1237,RREQ", ""},
+		{"PU5EPX-11", "PY5XYZ", "78,RRSP,R", "PU5EPX-12 -60 *PY5XYZ -70 PU5EPX-12 -65"},
+		{"QC", "PU5EPX-11", "1238,H=0123456789ab", "CQ CQ de PU5EPX"},
+		{"PY5XYZ", "PU5EPX-11", "1239,C,V=PU5EPX-12,H=0123456789ab", "hello there"},
+		{"PU5EPX-11", "PY5XYZ", "79,CO,R,S=,H=0123456789ab", "1239"},
+		{"PY5XYZ-1", "PU5EPX-11", "1240,SW,H=0123456789ab", "1 2"},
+	};
+	size_t text_len = 0;
+	size_t bin_len = 0;
+	int64_t text_air = 0;
+	int64_t bin_air = 0;
+	for (size_t i = 0; i < sizeof(mix) / sizeof(mix[0]); ++i) {
+		Packet m(Callsign(mix[i].to), Callsign(mix[i].from),
+			Params(Buffer(mix[i].params)), mix[i].msg);
+		Buffer t = m.encode_l3(200);
+		Buffer bm = m.encode_l3(200, true);
+		Ptr<Packet> d = Packet::decode_l3(bm.c_str(), bm.length(), -50, error);
+		assert(d->encoded() == m.encoded());
+		assert(bm.length() < t.length());
+		text_len += t.length();
+		bin_len += bm.length();
+		text_air += Airtime::of(t.length(), 2700);
+		bin_air += Airtime::of(bm.length(), 2700);
+	}
+	assert(bin_len < text_len);
+	printf("binary header: %d -> %d octets, %d -> %d ms airtime at 2700bps\n",
+		(int) text_len, (int) bin_len, (int) text_air, (int) bin_air);
+}
+
+void test19()
+{
+	Buffer z;
+	Buffer msg;
+
+	assert(Proto_Z_compress("") == "");
+	assert(Proto_Z_compress("ping").length() == 1);
+	assert(Proto_Z_compress("confirm 1234").length() == 4);
+	assert(Proto_Z_decompress(Proto_Z_compress("confirm 1234"), msg));
+	assert(msg == "confirm 1234");
+
+	// any octet survives a round trip
+	Buffer all;
+	for (int i = 255; i >= 0; --i) {
+		all += (char) i;
+	}
+	z = Proto_Z_compress(all);
+	assert(z.length() > all.length());
+	assert(Proto_Z_decompress(z, msg));
+	assert(msg == all);
+
+	// malformed
+	assert(!Proto_Z_decompress("abc\xff", msg));
+	assert(Proto_Z_decompress("\xff\xfe", msg));
+	assert(msg == "\xfe");
+
+	// tx compresses when it pays off, rx restores
+	Proto_Z proto(0);
+	Params p;
+	p.set_ident(1);
+	p.put_naked("Z");
+	Packet pkt(Callsign("PU5EPX"), Callsign("PY5XYZ"), p, "thanks for the ping", -70);
+	Ptr<Packet> c = proto.tx(pkt).pkt;
+	assert(c->params().has("Z"));
+	assert(c->msg().length() < pkt.msg().length());
+	int error;
+	Ptr<Packet> r = Packet::decode_l3(c->encoded().c_str(), c->encoded().length(), -70, error);
+	L4rxHandlerResponse rr = proto.rx(*r);
+	assert(!rr.error);
+	assert(rr.pkt->msg() == "thanks for the ping");
+	assert(rr.pkt->rssi() == -70);
+	assert(!proto.rx(pkt).error);
+
+	Packet pkt2(Callsign("PU5EPX"), Callsign("PY5XYZ"), p, "xyz");
+	Ptr<Packet> c2 = proto.tx(pkt2).pkt;
+	assert(!c2->params().has("Z"));
+	assert(c2->msg() == "xyz");
+	assert(!proto.rx(*c2).pkt);
+	Packet pkt3(Callsign("PU5EPX"), Callsign("PY5XYZ"), p, "\xff");
+	assert(proto.rx(pkt3).error);
+	p.remove("Z");
+	Packet pkt4(Callsign("PU5EPX"), Callsign("PY5XYZ"), p, "thanks");
+	assert(!proto.tx(pkt4).pkt);
+
+	// savings over a corpus of typical messages
+	const char *corpus[] = {
+		"hello, this is PU5EPX testing the network",
+		"KD8BXP good morning from the APRS gateway, are you there?",
+		"CQ CQ de PU5EPX-11 QTH Curitiba",
+		"73 and thanks for the QSO",
+		"confirm 1234",
+		"up 1d 03:25:40",
+		"ping",
+		"PU5EPX-12 -61 *PY5XYZ -70 PU5EPX-12 -66",
+		"N0CALL meeting at the club on Saturday at 10:00, bring your radio",
+		"temperature 25.0C humidity 61% pressure 1012.5hPa",
+		"I will be on the air tonight at 20:00 on 147.520 simplex",
+		"Testing the new antenna, signal report please",
+		"W1AW QSL via bureau, 5/9 here, name is John",
+		"Sensor batch 12: 22.5 22.7 22.9 23.0 23.4 23.1",
+	};
+	size_t plain_len = 0;
+	size_t z_len = 0;
+	int64_t plain_air = 0;
+	int64_t z_air = 0;
+	for (size_t i = 0; i < sizeof(corpus) / sizeof(corpus[0]); ++i) {
+		Buffer m = corpus[i];
+		z = Proto_Z_compress(m);
+		assert(Proto_Z_decompress(z, msg));
+		assert(msg == m);
+		assert(z.length() <= m.length());
+		plain_len += m.length();
+		z_len += z.length();
+		plain_air += Airtime::of(m.length(), 2700);
+		z_air += Airtime::of(z.length(), 2700);
+	}
+	assert(z_len * 4 < plain_len * 3);
+	printf("compression: %d -> %d octets, %d -> %d ms airtime at 2700bps\n",
+		(int) plain_len, (int) z_len, (int) plain_air, (int) z_air);
+}
+
+// Fragment of a message, as received
+static Ptr<Packet> fragment(const char *to, uint32_t ident, const char *f, const Buffer& msg)
+{
+	Params p;
+	p.set_ident(ident);
+	p.put("F", f);
+	if (Buffer(f).startsWith("100/0/")) {
+		p.put_naked("C");
+	}
+	return make_ptr<Packet>(Callsign(to), Callsign("BBBB"), p, msg, -80);
+}
+
+void test20()
+{
+	// short messages are not split
+	Params p;
+	p.set_ident(100);
+	Packet small(Callsign("AAAA"), Callsign("BBBB"), p, "hello");
+	assert(Proto_F::split(small, 200).count() == 1);
+
+	Buffer big;
+	for (size_t i = 0; i < 100; ++i) {
+		big += "0123456789";
+	}
+	Packet large(Callsign("AAAA"), Callsign("BBBB"), p, big);
+	Vector<Buffer> chunks = Proto_F::split(large, 200);
+	assert(chunks.count() == 7);
+	Buffer joined;
+	for (size_t i = 0; i < chunks.count(); ++i) {
+		Params pf = p;
+		pf.put("F", Buffer("100/") + Buffer::itoa(i) + "/7");
+		Packet f(Callsign("AAAA"), Callsign("BBBB"), pf, chunks[i]);
+		assert(f.encoded().length() + FRAG_HEADROOM <= 200);
+		joined += chunks[i];
+	}
+	assert(joined == big);
+	// room left for HMAC, R and the longest V added on the way
+	Params pv = p;
+	pv.put("V", "AB");
+	Packet routed(Callsign("AAAA"), Callsign("BBBB"), pv, big);
+	chunks = Proto_F::split(routed, 200);
+	for (size_t i = 0; i < chunks.count(); ++i) {
+		Params pf = (i == 0) ? pv : Params();
+		pf.set_ident(100 + i);
+		pf.put("F", Buffer("100/") + Buffer::itoa(i) + "/" + Buffer::itoa(chunks.count()));
+		pf.put("V", "ABCDEFG-12");
+		pf.put("H", "0123456789ab");
+		pf.put_naked("R");
+		Packet f(Callsign("AAAA"), Callsign("BBBB"), pf, chunks[i]);
+		assert(f.encoded().length() <= 200);
+	}
+	// capped at FRAG_MAX_COUNT fragments
+	Packet huge(Callsign("AAAA"), Callsign("BBBB"), p, big + big + big);
+	assert(Proto_F::split(huge, 200).count() == FRAG_MAX_COUNT);
+	// no room for a fragment
+	assert(Proto_F::split(large, 30).count() == 1);
+
+	// reassembly, out of order and with duplicates
+	Proto_F proto(0);
+	L4rxHandlerResponse r = proto.rx(*fragment("AAAA", 102, "100/2/3", "ghi"), 0);
+	// last fragment arrived first: ask for the rest
+	assert(r.hold && r.has_packet && !r.pkt);
+	assert(r.params.get("FR") == "100/0/1");
+	r = proto.rx(*fragment("AAAA", 101, "100/1/3", "def"), 10);
+	assert(r.hold && !r.pkt);
+	assert(proto.pending() == 1);
+	r = proto.rx(*fragment("AAAA", 101, "100/1/3", "def"), 20);
+	assert(r.hold && !r.pkt);
+	r = proto.rx(*fragment("AAAA", 100, "100/0/3", "abc"), 30);
+	assert(!r.hold && r.pkt);
+	assert(r.pkt->msg() == "abcdefghi");
+	assert(r.pkt->params().ident() == 100);
+	assert(r.pkt->params().has("C"));
+	assert(!r.pkt->params().has("F"));
+	assert(r.pkt->rssi() == -80);
+	assert(proto.pending() == 0);
+	// late copies are ignored
+	r = proto.rx(*fragment("AAAA", 102, "100/2/3", "ghi"), 40);
+	assert(r.hold && !r.pkt && !r.has_packet);
+
+	// missing fragments are asked for, once
+	r = proto.rx(*fragment("AAAA", 201, "200/1/4", "b"), 0);
+	r = proto.rx(*fragment("AAAA", 203, "200/3/4", "d"), 0);
+	assert(r.has_packet && r.hold);
+	assert(r.to == Callsign("BBBB"));
+	assert(r.params.get("FR") == "200/0/2");
+	r = proto.rx(*fragment("AAAA", 203, "200/3/4", "d"), 0);
+	assert(!r.has_packet);
+	// broadcast: nobody asks
+	r = proto.rx(*fragment("QC", 303, "300/2/3", "c"), 0);
+	assert(!r.has_packet);
+	assert(proto.pending() == 2);
+
+	// incomplete messages time out
+	proto.rx(*fragment("AAAA", 400, "400/0/2", "a"), 1000000);
+	assert(proto.pending() == 1);
+	r = proto.rx(*fragment("AAAA", 202, "200/2/4", "c"), 1000000);
+	assert(proto.pending() == 2);
+
+	// bounded reassembly, oldest dropped
+	for (uint32_t i = 0; i < FRAG_REASSEMBLY_SLOTS + 2; ++i) {
+		proto.rx(*fragment("AAAA", 500 + i, (Buffer::itoa(500 + i) + "/1/2").c_str(), "x"),
+			2000000 + i);
+	}
+	assert(proto.pending() == FRAG_REASSEMBLY_SLOTS);
+
+	// malformed
+	assert(proto.rx(*fragment("AAAA", 600, "600/2/2", "x"), 3000000).error);
+	assert(proto.rx(*fragment("AAAA", 600, "600/0/1", "x"), 3000000).error);
+	assert(proto.rx(*fragment("AAAA", 600, "600/0/33", "x"), 3000000).error);
+	assert(proto.rx(*fragment("AAAA", 600, "600/0", "x"), 3000000).error);
+	assert(proto.rx(*fragment("AAAA", 600, "600//2", "x"), 3000000).error);
+	assert(proto.rx(*fragment("AAAA", 600, "0/0/2", "x"), 3000000).error);
+	assert(proto.rx(*fragment("AAAA", 600, "600/0/2/3", "x"), 3000000).error);
+	assert(!proto.rx(*fragment("AAAA", 600, "600/0/2", "x"), 3000000).error);
+	assert(proto.rx(*fragment("AAAA", 601, "600/1/3", "x"), 3000000).error);
+	assert(!proto.rx(small, 3000000).hold);
+}
+
+// Reliable transport that records packets instead of sending them
+class TestRS: public Proto_RS {
+public:
+	TestRS(): Proto_RS(0) {}
+	Vector<Params> sent_params;
+	Vector<Buffer> sent_msgs;
+	Vector<bool> sent_held;
+	Vector<Buffer> failed;
+protected:
+	virtual void transmit(const Callsign&, const Params& params, const Buffer& msg, bool held)
+	{
+		sent_params.push_back(params);
+		sent_msgs.push_back(msg);
+		sent_held.push_back(held);
+	}
+	virtual void route_failed(const Callsign& to)
+	{
+		failed.push_back(Buffer(to));
+	}
+};
+
+static Ptr<Packet> rs_packet(const char *to, const char *from, uint32_t ident,
+				const char *params, const Buffer& msg)
+{
+	Params p(params);
+	p.set_ident(ident);
+	return make_ptr<Packet>(Callsign(to), Callsign(from), p, msg);
+}
+
+void test21()
+{
+	TestRS tx;
+	TestRS rx;
+	assert(tx.next_deadline(0) == MAX_IDLE_TIME);
+
+	// window of RS_WINDOW segments, the rest waits
+	Vector<Ptr<Packet>> sent;
+	for (uint32_t i = 0; i < RS_WINDOW + 2; ++i) {
+		auto r = tx.tx(*rs_packet("BBBB", "AAAA", 10 + i, "RS", "msg"), 0);
+		if (i < RS_WINDOW) {
+			assert(!r.hold);
+			assert(r.pkt->params().get("RS") == Buffer("10/") + Buffer::itoa(i + 1));
+			sent.push_back(r.pkt);
+		} else {
+			assert(r.hold);
+		}
+	}
+	assert(tx.in_flight(Callsign("BBBB")) == RS_WINDOW);
+	assert(tx.backlog(Callsign("BBBB")) == 2);
+	assert(tx.rto(Callsign("BBBB")) == 30000);
+	assert(tx.next_deadline(0) == 30000);
+
+	// delivered once, out of order
+	assert(!rx.rx(*sent[0], 0).hold);
+	assert(rx.next_deadline(0) == 2000);
+	assert(!rx.rx(*sent[2], 0).hold);
+	auto d = rx.rx(*sent[0], 0);
+	assert(d.hold && !d.has_packet);
+
+	// delayed standalone ack, with selective bitmask
+	rx.tick(1000);
+	assert(rx.sent_params.count() == 0);
+	rx.tick(2000);
+	assert(rx.sent_params.count() == 1);
+	assert(rx.sent_params[0].get("RA") == "10/1/2");
+	assert(rx.sent_params[0].has("RAO"));
+
+	// ack opens the window and samples RTT; ack-only pkt not delivered
+	Params ack = rx.sent_params[0];
+	ack.set_ident(500);
+	assert(tx.rx(Packet(Callsign("AAAA"), Callsign("BBBB"), ack, ""), 4000).hold);
+	assert(tx.in_flight(Callsign("BBBB")) == RS_WINDOW);
+	assert(tx.backlog(Callsign("BBBB")) == 0);
+	assert(tx.sent_params.count() == 2);
+	assert(tx.sent_params[0].get("RS") == Buffer("10/") + Buffer::itoa(RS_WINDOW + 1));
+	// sent under the packet ID given to the app when it was held
+	assert(tx.sent_held[0] && tx.sent_params[0].ident() == 10 + RS_WINDOW);
+	assert(tx.rto(Callsign("BBBB")) == 10000);
+
+	// ack piggybacked on return traffic
+	assert(!rx.rx(*sent[1], 5000).hold);
+	auto r = rx.tx(*rs_packet("AAAA", "BBBB", 501, "C", "reply"), 5000);
+	assert(r.pkt->params().get("RA") == "10/3/0");
+	assert(r.pkt->params().has("C"));
+	rx.tick(10000);
+	assert(rx.sent_params.count() == 1);
+
+	// retransmission of expired segments, with backoff
+	assert(tx.next_deadline(4000) == 6000);
+	assert(tx.tick(13000) == 11000);
+	assert(tx.sent_params.count() == 4);
+	assert(!tx.sent_held[2] && !tx.sent_held[3]);
+	assert(tx.sent_params[2].get("RS") == "10/4" || tx.sent_params[3].get("RS") == "10/4");
+	assert(tx.rto(Callsign("BBBB")) == 20000);
+	// route reported as failed once per timeout
+	assert(tx.failed.count() == 1 && tx.failed[0] == "BBBB");
+
+	// gives up eventually
+	for (int64_t t = 13000; t < 3600000; t += 60000) {
+		tx.tick(t);
+	}
+	assert(tx.in_flight(Callsign("BBBB")) == 0);
+	assert(tx.next_deadline(3600000) == MAX_IDLE_TIME);
+
+	// ... and the stream goes on past the segments given up
+	uint32_t delivered = 0;
+	for (uint32_t i = 0; i < 59; ++i) {
+		int64_t t = 3600000 + i * 3000;
+		auto m = tx.tx(*rs_packet("BBBB", "AAAA", 700 + i, "RS", "more"), t);
+		assert(!m.hold);
+		if (!rx.rx(*m.pkt, t).hold) {
+			++delivered;
+		}
+		rx.tick(t + 2000);
+		Params ra = rx.sent_params[rx.sent_params.count() - 1];
+		ra.set_ident(900 + i);
+		tx.rx(Packet(Callsign("AAAA"), Callsign("BBBB"), ra, ""), t + 2000);
+	}
+	assert(delivered == 59);
+	assert(tx.in_flight(Callsign("BBBB")) == 0);
+
+	// a receiver that forgot the stream picks it up midway
+	TestRS fresh;
+	assert(!fresh.rx(*rs_packet("AAAA", "BBBB", 800, "RS=10/100", "x"), 0).hold);
+	assert(!fresh.rx(*rs_packet("AAAA", "BBBB", 801, "RS=10/99", "x"), 0).hold);
+	assert(fresh.rx(*rs_packet("AAAA", "BBBB", 802, "RS=10/100", "x"), 0).hold);
+
+	// segments in flight never span beyond the receiver's bitmask
+	TestRS span;
+	for (uint32_t i = 0; i < 40; ++i) {
+		span.tx(*rs_packet("BBBB", "AAAA", 300 + i, "RS", "x"), 0);
+		span.rx(*rs_packet("AAAA", "BBBB", 400 + i, "RA=300/0/fffffffe,RAO", ""), 0);
+	}
+	assert(span.in_flight(Callsign("BBBB")) == 1);
+	assert(span.backlog(Callsign("BBBB")) == 8);
+
+	// RTT sampled from C/CO confirmation too
+	tx.tx(*rs_packet("CCCC", "AAAA", 49, "RS", "hi"), 0);
+	assert(!tx.tx(*rs_packet("CCCC", "AAAA", 50, "C", "hi"), 0).pkt);
+	tx.rx(*rs_packet("AAAA", "CCCC", 600, "CO", "confirm 50"), 8000);
+	assert(tx.rto(Callsign("CCCC")) == 24000);
+
+	// ... but CO does not create streams, nor evict busy ones
+	TestRS busy;
+	const char *peers[] = {"PY1AAA", "PY1BBB", "PY1CCC", "PY1DDD"};
+	for (uint32_t i = 0; i < RS_STREAMS; ++i) {
+		busy.tx(*rs_packet(peers[i % 4], "AAAA", 70 + i, "RS", "hi"), 0);
+	}
+	busy.tx(*rs_packet("PY1EEE", "AAAA", 80, "C", "hi"), 0);
+	busy.rx(*rs_packet("AAAA", "PY1EEE", 602, "CO", "confirm 80"), 1000);
+	for (uint32_t i = 0; i < RS_STREAMS; ++i) {
+		assert(busy.in_flight(Callsign(peers[i % 4])) == 1);
+	}
+
+	// CO missing after the timeout: route failed
+	TestRS lost;
+	lost.tx(*rs_packet("PY1EEE", "AAAA", 81, "C", "hi"), 0);
+	assert(lost.next_deadline(0) == 30000);
+	lost.tick(29000);
+	assert(lost.failed.count() == 0);
+	lost.tick(30000);
+	assert(lost.failed.count() == 1 && lost.failed[0] == "PY1EEE");
+	assert(lost.next_deadline(30000) == MAX_IDLE_TIME);
+
+	// not for broadcast
+	r = tx.tx(*rs_packet("QC", "AAAA", 51, "RS", "cq"), 0);
+	assert(!r.pkt->params().has("RS"));
+	assert(!tx.rx(*rs_packet("QC", "CCCC", 601, "RS=1/1", "cq"), 0).hold);
+}
+
+static Ptr<Packet> relay_packet(const char *to, const char *from, uint32_t ident,
+				const char *msg, bool sign)
+{
+	Params p;
+	p.set_ident(ident);
+	Ptr<Packet> pkt = make_ptr<Packet>(Callsign(to), Callsign(from), p, msg, -90);
+	if (sign) {
+		pkt = Proto_HMAC_tx(HMACKeys::get_key_for(pkt->from()), *pkt).pkt;
+	}
+	return pkt;
+}
+
+void test22()
+{
+	// repeater that verifies relays, with a key for PY stations
+	arduino_nvram_callsign_save(Callsign("PU5EPX-1"));
+	arduino_nvram_repeater_save(1);
+	arduino_nvram_verify_relay_save(1);
+	arduino_nvram_hmac_key_save("PY", "secret");
+	Network net;
+	int64_t now = sys_timestamp();
+	size_t queued = net.tx_queue().count();
+
+	// valid signature is relayed, verdict kept in recv log
+	Ptr<Packet> good = relay_packet("PY3XYZ", "PY2ABC", 10, "hello", true);
+	net.route(good, false, now);
+	assert(net.tx_queue().count() == ++queued);
+	RecvLogItem* good_item = net.recv_log_item(*good);
+	assert(good_item && good_item->hmac);
+
+	// forged and unsigned packets are not relayed
+	Ptr<Packet> forged = relay_packet("PY3XYZ", "PY2ABC", 11, "hello", true)->change_msg("bye");
+	net.route(forged, false, now);
+	assert(net.tx_queue().count() == queued);
+	RecvLogItem* forged_item = net.recv_log_item(*forged);
+	assert(forged_item && forged_item->hmac && forged_item->hmac != good_item->hmac);
+	net.route(relay_packet("PY3XYZ", "PY2ABC", 12, "hello", false), false, now);
+	assert(net.tx_queue().count() == queued);
+
+	// stations without a key need no signature
+	net.route(relay_packet("PY3XYZ", "PP5ABC", 13, "hello", false), false, now);
+	assert(net.tx_queue().count() == ++queued);
+
+	// verification runs once: the memoized verdict is trusted
+	assert(!Proto_HMAC_verify(&net, *good).error);
+	uint8_t ok = good_item->hmac;
+	good_item->hmac = forged_item->hmac;
+	assert(Proto_HMAC_verify(&net, *good).error);
+
+	// broadcast is delivered and relayed, verdict shared by both
+	Ptr<Packet> bcast = relay_packet("QC", "PY2ABC", 14, "cq", true);
+	net.route(bcast, false, now);
+	assert(net.tx_queue().count() == ++queued);
+	assert(net.recv_log_item(*bcast)->hmac == ok);
+
+	// no verification, forged packets are relayed
+	arduino_nvram_verify_relay_save(0);
+	Network net2;
+	net2.route(relay_packet("PY3XYZ", "PY2ABC", 15, "hello", true)->change_msg("bye"),
+			false, now);
+	assert(net2.tx_queue().count() == 1);
+
+	arduino_nvram_hmac_key_save("PY", "");
+	arduino_nvram_repeater_save(0);
+}
+
+void test23()
+{
+	// beacons go last, QR (repeater beacons) as well as QB
+	int64_t now = sys_timestamp();
+	size_t index;
+	int64_t wait;
+	const char *beacons[] = {"QB", "QR"};
+	for (size_t i = 0; i < 2; ++i) {
+		Network net;
+		net.route(relay_packet(beacons[i], "PU5EPX-1", 20, "beacon", false), true, now);
+		net.route(relay_packet("QC", "PU5EPX-1", 21, "cq", false), true, now);
+		assert(net.tx_queue().count() == 2);
+		assert(net.tx_queue().next(now, index, wait));
+		assert(net.tx_queue().frame(index).startsWith("QC<"));
+	}
+}
+
+void test24()
+{
+	// relay delay is weighted by RSSI of the received packet, which
+	// must survive the modifiers (Modf_R adds R)
+	arduino_nvram_repeater_save(1);
+	int64_t now = sys_timestamp();
+	const int rssi[2] = {RELAY_RSSI_FAR, RELAY_RSSI_NEAR};
+	int64_t total[2] = {0, 0};
+	int64_t airtime = 0;
+	for (uint32_t i = 0; i < 40; ++i) {
+		Network net;
+		Params p;
+		p.set_ident(30 + i);
+		net.route(make_ptr<Packet>(Callsign("PY3XYZ"), Callsign("PY2ABC"), p,
+				"hello", rssi[i % 2]), false, now);
+		size_t index;
+		int64_t wait;
+		if (net.tx_queue().next(now, index, wait)) {
+			wait = 0;
+		}
+		total[i % 2] += wait;
+		assert(net.tx_queue().next(now + MINUTES, index, wait));
+		const Buffer& frame = net.tx_queue().frame(index);
+		assert(strstr(frame.c_str(), ",R hello"));
+		airtime = Airtime::of(frame.length(), 2700);
+	}
+	// averages of 20 relays each: ~1.25x and ~3.75x the airtime
+	assert(total[0] < airtime * 2 * 20);
+	assert(total[1] > airtime * 3 * 20);
+	arduino_nvram_repeater_save(0);
+}
+
+// L4 protocol that logs the fragments sent, in order
+class FragmentLog: public L4Protocol {
+public:
+	FragmentLog(Network* net, Vector<Buffer>& log): L4Protocol(net), log(log) {}
+	virtual L4rxHandlerResponse rx(const Packet&)
+	{
+		return L4rxHandlerResponse();
+	}
+	virtual L4txHandlerResponse tx(const Packet& pkt)
+	{
+		if (pkt.params().has("F")) {
+			Buffer route = pkt.params().has("V") ? " V" : "";
+			log.push_back(pkt.params().s_ident() + " " + pkt.params().get("F") + route);
+		}
+		return L4txHandlerResponse();
+	}
+private:
+	Vector<Buffer>& log;
+};
+
+void test25()
+{
+	// fragments are sent in order, the first under the ID of the msg
+	Network net;
+	Vector<Buffer> log;
+	net.add_l4protocol(make_ptr<FragmentLog>(&net, log));
+	Buffer big;
+	for (size_t i = 0; i < 50; ++i) {
+		big += "0123456789";
+	}
+	Params p;
+	p.put("V", "PU5ABC");
+	uint32_t id = net.send(Callsign("PY3XYZ"), p, big);
+	size_t count = log.count();
+	assert(count >= 3);
+	Buffer sid = Buffer::itoa(id);
+	for (size_t i = 0; i < count; ++i) {
+		Buffer f = sid + "/" + Buffer::itoa(i) + "/" + Buffer::itoa(count);
+		if (i == 0) {
+			assert(log[i] == sid + " " + f);
+		} else {
+			assert(log[i] == Buffer::itoa(id + i) + " " + f);
+		}
+	}
+
+	// first fragment sent again without the stale route
+	Params fr;
+	fr.set_ident(900);
+	fr.put("FR", sid + "/0");
+	net.route(make_ptr<Packet>(net.me(), Callsign("PY3XYZ"), fr, ""), false,
+			sys_timestamp());
+	assert(log.count() == count + 1);
+	assert(log[count] == Buffer::itoa(id + count) + " " + sid + "/0/" + Buffer::itoa(count));
+}
+
+// L4 protocol that logs the explicit route of each packet sent
+class RouteLog: public L4Protocol {
+public:
+	RouteLog(Network* net, Vector<Buffer>& log): L4Protocol(net), log(log) {}
+	virtual L4rxHandlerResponse rx(const Packet&)
+	{
+		return L4rxHandlerResponse();
+	}
+	virtual L4txHandlerResponse tx(const Packet& pkt)
+	{
+		const Params& p = pkt.params();
+		log.push_back(p.has("S") ? Buffer("S=") + p.get("S")
+				: p.has("V") ? Buffer("V=") + p.get("V") : Buffer());
+		return L4txHandlerResponse();
+	}
+private:
+	Vector<Buffer>& log;
+};
+
+// Overhear a RRSP that went through us and PU5ABC on to PY3XYZ
+static void learn_route(Network& net)
+{
+	Params p;
+	p.set_ident(77);
+	p.put_naked("RRSP");
+	Buffer path = Buffer(net.me()) + " -50 PU5ABC -60 *PY3XYZ -70";
+	net.route(make_ptr<Packet>(Callsign("PY1OTH"), Callsign("PY3XYZ"), p, path),
+			false, sys_timestamp());
+}
+
+// RRSP from PY3XYZ answering our RREQ, through PU5ABC
+static void answer_rreq(Network& net, uint32_t ident)
+{
+	Params p;
+	p.set_ident(ident);
+	p.put_naked("RRSP");
+	net.route(make_ptr<Packet>(net.me(), Callsign("PY3XYZ"), p,
+			"PU5ABC -60 *PY3XYZ -70 PU5ABC -65"), false, sys_timestamp());
+}
+
+void test26()
+{
+	// explicit routing is off by default
+	Vector<Buffer> log;
+	Network off;
+	off.add_l4protocol(make_ptr<RouteLog>(&off, log));
+	learn_route(off);
+	off.send(Callsign("PY3XYZ"), Params(), "hi");
+	answer_rreq(off, 78);
+	off.send(Callsign("PY3XYZ"), Params(), "hi");
+	assert(log.count() == 2 && log[0] == "" && log[1] == "");
+	log.clear();
+
+	arduino_nvram_explicit_route_save(1);
+	Network net;
+	net.add_l4protocol(make_ptr<RouteLog>(&net, log));
+	learn_route(net);
+	net.send(Callsign("PY3XYZ"), Params(), "hi");
+	assert(log[0] == "V=PU5ABC");
+
+	// after a failure, diffusion
+	net.route_failed(Callsign("PY3XYZ"));
+	net.send(Callsign("PY3XYZ"), Params(), "hi");
+	assert(log[1] == "");
+
+	// source route dropped on failure, until a new RRSP
+	answer_rreq(net, 78);
+	net.send(Callsign("PY3XYZ"), Params(), "hi");
+	assert(log[2] == "S=PU5ABC");
+	net.route_failed(Callsign("PY3XYZ"));
+	net.send(Callsign("PY3XYZ"), Params(), "hi");
+	assert(log[3] == "");
+	answer_rreq(net, 79);
+	net.send(Callsign("PY3XYZ"), Params(), "hi");
+	assert(log[4] == "S=PU5ABC");
+	arduino_nvram_explicit_route_save(0);
+
+	RouteTable rt(8, 1000);
+	rt.fail("BBBB", 0);
+	assert(rt.failed("BBBB"));
+	assert(!rt.failed("CCCC"));
+	rt.expire(1001);
+	assert(!rt.failed("BBBB"));
+	assert(rt.add_source_route("CCCC -60 *DDDD -70", 1001));
+	rt.fail("DDDD", 1001);
+	assert(rt.source_route("DDDD").empty());
+	assert(rt.add_source_route("CCCC -60 *DDDD -70", 1002));
+	assert(!rt.failed("DDDD"));
+	assert(rt.source_route("DDDD") == "CCCC");
+}
+
 int main()
 {
 	Buffer key = HMACKeys::hash_key("abracadabra");
@@ -244,6 +1655,23 @@ int main()
 	assert(key == "9b801f436eeb78055b4d77d9773bbae5"); // calculated with test_hmac.py
 	Buffer hmac = HMACKeys::hmac(key, "BBBBAAAA23Ola");
 	assert(hmac == "10d872720ebe"); // calculated with test_hmac.py
+	// cached key states, long key, empty and multi-block messages
+	Buffer long_key = Buffer("kkkkkkkkkk") + "kkkkkkkkkk" + "kkkkkkkkkk" + "kkkkkkkkkk" + "kkkkkkkkkk";
+	long_key = long_key + long_key;
+	assert(HMACKeys::hmac(long_key, "BBBBAAAA23Ola") == "d8af4ddb7845");
+	assert(HMACKeys::hmac("abc", "") == "e26360775067");
+	Buffer long_msg;
+	for (size_t i = 0; i < 200; ++i) {
+		long_msg += 'x';
+	}
+	assert(HMACKeys::hmac("abc", long_msg) == "f2ceb2335548");
+	assert(HMACKeys::hmac(key, "BBBBAAAA23Ola") == "10d872720ebe");
+	HMACHasher hasher(key);
+	hasher.write("BBBB", 4);
+	hasher.write(Buffer("AAAA"));
+	hasher.write("", 0);
+	hasher.write("23Ola", 5);
+	assert(hasher.result() == "10d872720ebe");
 	Params d23;
 	d23.set_ident(23);
 	Packet p23(Callsign(Buffer("BBBB")), Callsign(Buffer("AAAA")), d23, Buffer("Ola"));
@@ -297,6 +1725,18 @@ int main()
 	assert (!Callsign("a-1").is_valid());
 	assert (!Callsign("aaaa-1-2").is_valid());;
 	assert (!Callsign("aaaa-123").is_valid());
+	assert (Callsign(" pu5epx-1 ") == Callsign("PU5EPX-1"));
+	assert (Callsign("PU5EPX-1") == Buffer("pu5epx-1"));
+	assert (!(Callsign("PU5EPX-1") == Buffer("pu5epx-12")));
+	assert (Callsign("PU5EPX-1") != Callsign("PU5EPX-11"));
+	assert (!(Callsign() == Callsign()));
+	assert (Callsign("pu5epx").hash() == Callsign::hash(BufferView("PU5EPX", 6)));
+	assert (Buffer(Callsign("aaaaaaa-99")) == "AAAAAAA-99");
+	assert (Callsign("QR").is_repeater() && Callsign("QR").is_bcast());
+	assert (Callsign("QB").is_reserved() && !Callsign("QB").is_repeater());
+	assert (Callsign("QC").is_bcast() && !Callsign("QC").is_reserved());
+	assert (!Callsign("QX").is_bcast() && Callsign("QX").is_q());
+	assert (!Callsign("PU5EPX").is_q());
 
 	test3();
 
@@ -313,6 +1753,27 @@ int main()
 	test2();
 	test4();
 	test5();
+	test6();
+	test7();
+	test8();
+	test9();
+	test10();
+	test11();
+	test12();
+	test13();
+	test14();
+	test15();
+	test16();
+	test17();
+	test18();
+	test19();
+	test20();
+	test21();
+	test22();
+	test23();
+	test24();
+	test25();
+	test26();
 
 	Packet plong3(Callsign(Buffer("AAAAAAA-11")), Callsign(Buffer("BBBBBB-22")), d, Buffer("012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789"));
 	Buffer b3 = plong3.encode_l3(200);
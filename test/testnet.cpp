@@ -118,9 +118,16 @@ void sendm()
 		exit(2);
 	}
 	char *cmd;
-	int opt = arduino_random2(0, 4);
+	int opt = arduino_random2(0, 7);
 	if (opt == 0) {
 		asprintf(&cmd, "%s ola\r", scs.c_str());
+	} else if (opt == 6) {
+		asprintf(&cmd, "%s:RS reliable ola\r", scs.c_str());
+	} else if (opt == 5) {
+		// fragmented
+		asprintf(&cmd, "%s:C long %0400d end\r", scs.c_str(), 7);
+	} else if (opt == 4) {
+		asprintf(&cmd, "%s:C,Z hello, thanks for the test message\r", scs.c_str());
 	} else if (opt == 1) {
 		asprintf(&cmd, "%s:C ola\r", scs.c_str());
 	} else if (opt == 2) {
@@ -183,6 +190,13 @@ int main(int argc, char* argv[])
 	cli_simtype(cli_cmd);
 	sprintf(cli_cmd, "!callsign %s\r", argv[1]);
 	cli_simtype(cli_cmd);
+	// mixed network: repeaters originate binary headers
+	cli_simtype("!binhdr a\r");
+	sprintf(cli_cmd, "!binhdr %d\r", repeater);
+	cli_simtype(cli_cmd);
+	cli_simtype("!binhdr\r");
+	cli_simtype("!exroute 1\r");
+	cli_simtype("!exroute\r");
 	sprintf(cli_cmd, "!hmacpsk %s\r", argv[4]);
 	cli_simtype(cli_cmd);
 
@@ -239,7 +253,7 @@ int main(int argc, char* argv[])
 	logs("test", "test");
 
 	// Add a couple of old data to exercise cleanup run paths
-	Net->_recv_log()["UNKNOWN:1234"] = RecvLogItem(-50, -90 * 60 * 1000);
+	Net->_recv_log().put(Callsign("UNKNOWN"), 1234, RecvLogItem(-50, -90 * 60 * 1000));
 	Net->_neighbors()["UNKNOWN"] = Peer(-50, -90 * 60 * 1000);
 	Net->_peers()["UNKNOWN"] = Peer(-50, -90 * 60 * 1000);
 	Net->_repeaters()["UNKNOWN"] = Peer(-50, -90 * 60 * 1000);
@@ -268,6 +282,8 @@ int main(int argc, char* argv[])
 		} else if (arduino_random2(0, 100) == 0) {
 			cli_simtype("!neigh\r");
 			cli_simtype("!uptime\r");
+			cli_simtype("!stats\r");
+			cli_simtype("!routes\r");
 		}
 
 		Ptr<Task> tsk = Net->_task_mgr().next_task();